@@ -0,0 +1,67 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/* Block layer benchmark suite, built on uboot_blk_bench_run.
+ *
+ * Each target (raw blocks of a device, or a file within a filesystem) is run
+ * through sequential and random reads, and optionally writes, at each of a
+ * list of operation sizes. Results are emitted as a CBOR array of maps,
+ * base64 encoded (see utils/cbor64.h), one map per run:
+ *
+ *   { "target", "iface", "kind" ("raw" or "file"), "workload", "io_size",
+ *     "error", "operations", "bytes", "elapsed_us", "kib_per_s",
+ *     "p50_ns", "p90_ns", "p99_ns", "max_ns" }
+ *
+ * A run which failed records a negative "error" and no measurements, so that
+ * the shape of the output is the same from one build to the next for
+ * regression tracking.
+ *
+ * Raw targets without a media card may use a ramdisk created by
+ * uboot_ramdisk_create, on the "host" interface.
+ *
+ * blk_bench_compare_load compares the time taken to load an image with the
+ * time to load compressed copies of it through uboot_fs_load, emitting one
+ * map per file:
+ *
+ *   { "path", "codec" ("none", "lz4" or "gzip"), "error", "file_bytes",
+ *     "loaded_bytes", "read_us", "decompress_us", "elapsed_us" }
+ *
+ * The uncompressed image is read in a single read as by 'fatload', giving
+ * the baseline against which the compressed loads are judged.
+ */
+
+typedef struct {
+    const char *name;           // label recorded with each result
+    const char *iface;          // e.g. "mmc", "usb" or "host"
+    int devnum;                 // device number, for raw blocks
+    const char *part;           // device and partition, for a file
+    const char *path;           // file, or NULL for raw blocks
+    unsigned long lba_start;    // region of a raw device used
+    unsigned long lba_count;    // size of the region, zero for the whole device
+    bool writes;                // also run the write workloads
+} blk_bench_target_t;
+
+typedef struct {
+    const char *iface;          // e.g. "mmc" or "usb"
+    const char *part;           // device and partition
+    const char *plain_path;     // the uncompressed image
+    const char *lz4_path;       // LZ4 frame copy, or NULL
+    const char *gzip_path;      // gzip copy, or NULL
+    int repeats;                // loads of each file
+} blk_bench_load_t;
+
+// Function prototypes
+int blk_bench_run_suite(const blk_bench_target_t *targets, int target_count,
+                        const unsigned long *io_sizes, int io_size_count,
+                        unsigned long long total, FILE *output);
+int blk_bench_compare_load(const blk_bench_load_t *load, void *buffer,
+                           unsigned long buffer_size, FILE *output);
@@ -0,0 +1,65 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Classification of received frames to the clients of the ethernet driver
+ * server.
+ *
+ * Rules match a single header field exactly, and are held in a sorted table
+ * per field so that a frame is classified by at most one binary search per
+ * field. Fields are tried from the most to the least specific:
+ *
+ *   UDP destination port -> IPv4 protocol -> EtherType -> destination MAC
+ *
+ * and the first matching rule determines the client. Frames matching no rule
+ * go to the default client, initially the first client, or are dropped if the
+ * default is set to NET_CLASSIFY_DROP. A fragmented UDP datagram is matched
+ * without its ports, which only its first fragment carries, so that all of
+ * its fragments reach the same client.
+ *
+ * Rules and the default may only name clients below the count set by
+ * net_classify_set_client_count, so are configured after the ethernet
+ * driver server sets it on initialisation; until then every rule is
+ * rejected. Frames for a client beyond a later, smaller count are dropped.
+ * net_classify_clear removes every rule and restores the default client.
+ *
+ * Each rule counts the frames and bytes it has matched. Dropped frames are
+ * also counted together, whatever the reason.
+ */
+
+/* Maximum number of rules for each field */
+#define NET_CLASSIFY_MAX_RULES  16
+
+/* Client index indicating the frame is to be dropped */
+#define NET_CLASSIFY_DROP       (-1)
+
+typedef enum {
+    NET_MATCH_UDP_PORT,     // UDP destination port of an IPv4 datagram
+    NET_MATCH_IP_PROTO,     // protocol of an IPv4 datagram
+    NET_MATCH_ETHERTYPE,    // EtherType, following any 802.1Q tag
+    NET_MATCH_DST_MAC,      // destination MAC address, most significant byte first
+    NET_MATCH_FIELDS
+} net_match_t;
+
+typedef struct {
+    uint64_t frames;
+    uint64_t bytes;
+} net_classify_count_t;
+
+// Function prototypes
+int net_classify_add_rule(net_match_t field, uint64_t value, int client);
+void net_classify_clear(void);
+void net_classify_set_client_count(int count);
+int net_classify_set_default(int client);
+int net_classify(const uint8_t *frame, int length);
+int net_classify_get_count(net_match_t field, uint64_t value, net_classify_count_t *count);
+void net_classify_get_default_count(net_classify_count_t *count);
+void net_classify_get_dropped_count(net_classify_count_t *count);
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Single producer, single consumer queues of packet buffer descriptors held
+ * in memory shared between two protection domains.
+ *
+ * Descriptors refer to buffers by their offset within a shared data region,
+ * as each protection domain may map that region at a different address.
+ * Packet data is therefore never copied through the queues.
+ *
+ * Each side only ever writes one of the head and tail indices, so no locking
+ * is required. To avoid a notification per packet the consumer requests a
+ * signal only once it has found its queue empty, and the producer signals
+ * at most once per batch.
+ */
+
+typedef struct {
+    uint64_t offset;    // offset of the buffer within the shared data region
+    uint16_t length;    // length of the packet held in the buffer
+} net_buff_desc_t;
+
+typedef struct {
+    volatile uint32_t head __attribute__((aligned(64)));    // written by the producer only
+    volatile uint32_t tail __attribute__((aligned(64)));    // written by the consumer only
+    volatile bool signal_requested __attribute__((aligned(64)));
+    net_buff_desc_t entries[];
+} net_queue_t;
+
+/* Each direction of traffic uses a pair of queues: 'active' carries buffers
+ * holding packets, 'free' returns the emptied buffers to their owner. */
+typedef struct {
+    net_queue_t *free;
+    net_queue_t *active;
+    uint32_t size;      // number of entries in each queue, a power of 2
+} net_queue_handle_t;
+
+/* Size of the shared memory needed for a queue of 'size' entries */
+#define NET_QUEUE_REGION_SIZE(size) \
+    (sizeof(net_queue_t) + (size) * sizeof(net_buff_desc_t))
+
+// Function prototypes
+void net_queue_init(net_queue_handle_t *handle, uintptr_t free, uintptr_t active, uint32_t size);
+void net_queue_reset(net_queue_t *queue);
+uint32_t net_queue_length(net_queue_t *queue);
+bool net_queue_empty(net_queue_t *queue);
+bool net_queue_full(net_queue_t *queue, uint32_t size);
+int net_queue_enqueue(net_queue_t *queue, uint32_t size, net_buff_desc_t desc);
+int net_queue_dequeue(net_queue_t *queue, uint32_t size, net_buff_desc_t *desc);
+void net_queue_request_signal(net_queue_t *queue);
+void net_queue_cancel_signal(net_queue_t *queue);
+bool net_queue_require_signal(net_queue_t *queue);
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <microkit.h>
+#include <net_queue.h>
+
+/* Ethernet driver server, sharing the single ethernet device managed by the
+ * U-Boot driver library between several client protection domains.
+ *
+ * The server PD initialises the driver library and calls 'net_server_init'
+ * followed by 'net_server_notified' from its notification handler. Each
+ * client is connected to the server by a channel and two pairs of shared
+ * queues (see net_queue.h):
+ *
+ *  - rx: the server places received frames on 'active'; the client returns
+ *    each buffer on 'free' once finished with it. Receive buffers are loaned
+ *    directly from the device's receive ring and are referenced by their
+ *    offset within the server's DMA region, which must be mapped read-only
+ *    into the client. A client may only return the buffers given to it;
+ *    any others are rejected.
+ *  - tx: the client places frames to send on 'active', referenced by their
+ *    offset within its own transmit data region shared with the server. The
+ *    server returns each buffer on 'free' once it has been queued on the
+ *    device's transmit ring, or with a length of zero if the device failed
+ *    to send it.
+ *
+ * Clients follow the signalling protocol of net_queue.h: after enqueuing a
+ * batch on either of its 'free' or 'active' queues, a client notifies the
+ * server only if net_queue_require_signal reports that it is waiting.
+ *
+ * Received frames are steered to clients by the rules of net_classify.h,
+ * which may be configured at any time by the server PD once net_server_init
+ * has set the number of clients the rules may name.
+ */
+
+/* Maximum number of clients served */
+#define NET_SERVER_MAX_CLIENTS  8
+
+typedef struct {
+    microkit_channel channel;   // channel used to notify the client
+    net_queue_handle_t rx;      // received frames to the client
+    net_queue_handle_t tx;      // frames to send from the client
+    uintptr_t tx_data;          // server's mapping of the client's transmit data region
+    size_t tx_data_size;
+} net_client_config_t;
+
+typedef struct {
+    microkit_channel irq_channel;   // channel on which the device IRQ is delivered
+    uintptr_t rx_data;              // server's mapping of its DMA region
+    size_t rx_data_size;
+    int client_count;
+    net_client_config_t clients[NET_SERVER_MAX_CLIENTS];
+} net_server_config_t;
+
+// Function prototypes
+int net_server_init(const net_server_config_t *config);
+void net_server_notified(microkit_channel ch);
+unsigned long net_server_tx_failed(int client);
@@ -24,11 +24,25 @@ int microkit_dma_init(
     bool cached)
 NONNULL(1) WARN_UNUSED_RESULT;
 
+/* Add a pool of memory mapped uncached to the dma allocator, from which
+ * allocations requesting uncached memory are made (e.g. descriptor rings
+ * shared with a device at a finer granularity than a cache line). As the
+ * physical address of the pool cannot be derived from that of the cached
+ * pool, it is given here. Only a single uncached pool is supported.
+ */
+int microkit_dma_init_uncached(
+    void *dma_pool,
+    uintptr_t dma_pool_paddr,
+    size_t dma_pool_sz,
+    size_t page_size)
+NONNULL(1) WARN_UNUSED_RESULT;
+
 /**
  * Allocate memory to be used for DMA.
  *
  * @param size Size in bytes to allocate
  * @param align Alignment constraint in bytes (0 == none)
+ * @param cached Whether the memory is to be mapped cached
  *
  * @return Virtual address of allocation or NULL on failure
  */
@@ -27,6 +27,13 @@
 extern uintptr_t dma_base;
 extern uintptr_t dma_cp_paddr;
 
+/* The pool mapped uncached, if any. Unlike the cached pool its location is
+ * not provided by the system file, so is recorded by
+ * microkit_dma_init_uncached. */
+static uintptr_t uncached_vaddr;
+static uintptr_t uncached_paddr;
+static size_t uncached_size;
+
 
 /* NOT THREAD SAFE. The code could be made thread safe relatively easily by
  * operating atomically on the free list.
@@ -482,10 +489,44 @@ int microkit_dma_init(
 }
 
 
+static bool is_uncached(
+    void *ptr)
+{
+    return uncached_size != 0 && (uintptr_t)ptr >= uncached_vaddr &&
+           (uintptr_t)ptr - uncached_vaddr < uncached_size;
+}
+
+int microkit_dma_init_uncached(
+    void *dma_pool,
+    uintptr_t dma_pool_paddr,
+    size_t dma_pool_sz,
+    size_t page_size)
+{
+    if (uncached_size != 0) {
+        return -1;
+    }
+
+    /* Record the pool first; initialisation looks up physical addresses */
+    uncached_vaddr = (uintptr_t)dma_pool;
+    uncached_paddr = dma_pool_paddr;
+    uncached_size = dma_pool_sz;
+
+    int ret = microkit_dma_init(dma_pool, dma_pool_sz, page_size, false);
+    if (ret != 0) {
+        uncached_size = 0;
+    }
+
+    return ret;
+}
+
 /* Get physical address from virtual address, dma_cp_paddr is provided in the system file */
 uintptr_t microkit_dma_get_paddr(
     void *ptr)
 {
+    if (is_uncached(ptr)) {
+        return uncached_paddr + ((uintptr_t)ptr - uncached_vaddr);
+    }
+
     int offset = (uint64_t)ptr - (int)dma_base;
     return (uintptr_t*)(dma_cp_paddr+offset);
 }
@@ -702,8 +743,8 @@ void microkit_dma_free(
     void *ptr,
     size_t size)
 {
-    // Cached is set to true in the system file 
-    bool cached = 1;
+    /* Return the region to the pool it was allocated from */
+    bool cached = !is_uncached(ptr);
 
     /* Call the common function to free the DMA memory */
     free_region(ptr, size, cached);
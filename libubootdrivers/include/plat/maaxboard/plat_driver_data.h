@@ -15,7 +15,7 @@
 
 /* Define the number of different driver elements to be used on this platform */
 #define _u_boot_uclass_driver_count     21
-#define _u_boot_driver_count            33
+#define _u_boot_driver_count            35
 #define _u_boot_usb_driver_entry_count  3
 #define _u_boot_part_driver_count       4
 #define _u_boot_cmd_count               29
@@ -81,6 +81,8 @@ extern struct driver _u_boot_driver__fixed_clock;
 extern struct driver _u_boot_driver__clk_fixed_rate_raw;
 extern struct driver _u_boot_driver__clk_gate;
 extern struct driver _u_boot_driver__ccf_clk_mux;
+extern struct driver _u_boot_driver__uboot_ramdisk_blk;
+extern struct driver _u_boot_driver__uboot_tftp_loopback_eth;
 
 /* Define the driver entries to be used on this platform */
 extern struct usb_driver_entry _u_boot_usb_driver_entry__usb_generic_hub;
@@ -15,7 +15,7 @@
 
 /* Define the number of different driver elements to be used on this platform */
 #define _u_boot_uclass_driver_count     9
-#define _u_boot_driver_count            7
+#define _u_boot_driver_count            8
 #define _u_boot_usb_driver_entry_count  0
 #define _u_boot_part_driver_count       0
 #define _u_boot_cmd_count               6
@@ -43,6 +43,7 @@ extern struct driver _u_boot_driver__meson_gxbb_pinctrl;
 extern struct driver _u_boot_driver__meson_gx_gpio_driver;
 extern struct driver _u_boot_driver__led_gpio_wrap;
 extern struct driver _u_boot_driver__led_gpio;
+extern struct driver _u_boot_driver__uboot_ramdisk_blk;
 
 /* Define the driver entries to be used on this platform */
 
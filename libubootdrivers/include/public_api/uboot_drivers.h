@@ -74,6 +74,80 @@ int uboot_stdin_getc();
  */
 int uboot_eth_init(void);
 
+/**
+ * Sizing of the ethernet rings. Any field left as zero takes its default.
+ *
+ * @rx_ring_size: number of receive descriptors, i.e. the number of frames
+ *    the device can absorb before the client collects them (default 32).
+ * @rx_spare_buffers: number of additional receive buffers, bounding the
+ *    number of received packets the client may hold (default 32).
+ * @tx_ring_size: number of transmit descriptors (default 32).
+ * @tx_buffers: number of buffers available through
+ *    uboot_eth_alloc_tx_buffer (default 64).
+ * @buffer_size: size of each buffer in bytes, a multiple of the cache line
+ *    size between 256 and 1536 (default 1536). Larger frames are dropped
+ *    on receipt and rejected for transmission.
+ *
+ * Each ring must hold at least two descriptors. Rings of up to 4096 entries
+ * in total are supported. The descriptor rings are allocated from the
+ * uncached DMA pool (see microkit_dma_init_uncached); without one the
+ * sizing is ignored and the driver sends and receives synchronously.
+ */
+struct uboot_eth_config {
+    unsigned int rx_ring_size;
+    unsigned int rx_spare_buffers;
+    unsigned int tx_ring_size;
+    unsigned int tx_buffers;
+    unsigned int buffer_size;
+};
+
+/**
+ * uboot_eth_init_config() - Initialise ethernet with the given ring sizing.
+ *
+ * As uboot_eth_init, which uses the default sizing (or that of a previous
+ * call). The sizing can only be changed while ethernet is halted and no
+ * received packets or transmit buffers are held by the client. Where the
+ * driver does not support ring management the sizing is ignored.
+ *
+ * @config: the ring sizing, or NULL to retain the current sizing.
+ *
+ * Return: 0 if OK, otherwise failure.
+ */
+int uboot_eth_init_config(const struct uboot_eth_config *config);
+
+/* Ethernet initialisation states returned by uboot_eth_init_async and
+ * uboot_eth_link_poll */
+#define UBOOT_ETH_LINK_HALTED   0
+#define UBOOT_ETH_LINK_PENDING  1
+#define UBOOT_ETH_LINK_UP       2
+
+/**
+ * uboot_eth_init_async() - Initialise ethernet without waiting for the link.
+ *
+ * uboot_eth_init waits (for up to several seconds) for any autonegotiation
+ * in progress on the PHY to complete. Instead, if the link is already up
+ * with negotiated parameters, ethernet is initialised immediately without
+ * renegotiating. Otherwise negotiation is left to run in the background
+ * (being started if the PHY is not already negotiating) and the call returns
+ * UBOOT_ETH_LINK_PENDING. The caller then polls uboot_eth_link_poll, which
+ * completes initialisation once the link is up, before using the other
+ * uboot_eth_xxx routines.
+ *
+ * Where the link state cannot be determined this behaves as uboot_eth_init.
+ *
+ * Return: negative on error, otherwise the initialisation state.
+ */
+int uboot_eth_init_async(void);
+
+/**
+ * uboot_eth_link_poll() - Poll the progress of uboot_eth_init_async.
+ *
+ * Return: negative on error, otherwise UBOOT_ETH_LINK_UP once ethernet is
+ *    initialised, UBOOT_ETH_LINK_PENDING while awaiting the link, or
+ *    UBOOT_ETH_LINK_HALTED if not initialised.
+ */
+int uboot_eth_link_poll(void);
+
 /**
  * uboot_eth_halt() - Halts ethernet, the opposite of uboot_eth_init.
  *    Once halted the uboot_eth_init must again be called before other
@@ -83,6 +157,60 @@ int uboot_eth_init(void);
  */
 void uboot_eth_halt(void);
 
+/* Opaque handle to the resolved ethernet device */
+struct uboot_eth_handle;
+
+/**
+ * uboot_eth_open() - Resolve the active ethernet device for use with the
+ *    uboot_eth_handle_xxx routines.
+ *
+ * The device lookup and state checks performed on every call of the
+ * uboot_eth_xxx routines are instead performed once here. Must be called
+ * after uboot_eth_init; the handle is invalidated by uboot_eth_halt, or by
+ * a command run through run_uboot_command which leaves the device halted,
+ * after which the handle routines fail until uboot_eth_open is called again.
+ *
+ * Return: the handle if OK, otherwise NULL.
+ */
+struct uboot_eth_handle *uboot_eth_open(void);
+
+/**
+ * uboot_eth_handle_send() - Send an ethernet packet through an open handle.
+ *    Otherwise as uboot_eth_send.
+ *
+ * @handle: the handle returned by uboot_eth_open.
+ * @packet: pointer to the buffer to send.
+ * @length: length of the buffer to send.
+ *
+ * Return: 0 if OK, otherwise failure.
+ */
+int uboot_eth_handle_send(struct uboot_eth_handle *handle, unsigned char *packet,
+    int length);
+
+/**
+ * uboot_eth_handle_receive() - Receive an ethernet packet through an open
+ *    handle. Otherwise as uboot_eth_receive.
+ *
+ * @handle: the handle returned by uboot_eth_open.
+ * @packet: pointer to the allocated buffer. The buffer must be free'd by
+ *    calling uboot_eth_handle_free_packet (or uboot_eth_free_packet).
+ *
+ * Return: negative on error, 0 if no packet available, otherwise returns
+ *    the length of the received packet.
+ */
+int uboot_eth_handle_receive(struct uboot_eth_handle *handle, unsigned char **packet);
+
+/**
+ * uboot_eth_handle_free_packet() - Frees a packet buffer previously
+ *    received through uboot_eth_handle_receive.
+ *
+ * @handle: the handle returned by uboot_eth_open.
+ * @packet: pointer to the buffer to free.
+ *
+ * Return: 0 if OK, otherwise failure.
+ */
+int uboot_eth_handle_free_packet(struct uboot_eth_handle *handle, unsigned char **packet);
+
 /**
  * uboot_eth_send() - Send an ethernet packet.
  *
@@ -93,9 +221,34 @@ void uboot_eth_halt(void);
  */
 int uboot_eth_send(unsigned char *packet, int length);
 
+/**
+ * uboot_eth_send_burst() - Send a batch of ethernet packets.
+ *
+ * Where supported by the driver the packets are queued on the transmit
+ * ring with a single notification to the device, and the call returns
+ * without waiting for them to be transmitted. Descriptors of completed
+ * transmissions are reclaimed on later calls. The packet data is copied,
+ * so the buffers may be reused as soon as the call returns.
+ *
+ * @packets: array of pointers to the buffers to send.
+ * @lengths: array of the lengths of the buffers to send.
+ * @count: the number of packets to send.
+ *
+ * Return: negative on error, otherwise the number of packets queued. This
+ *    may be less than 'count' if the transmit ring is full.
+ */
+int uboot_eth_send_burst(unsigned char **packets, int *lengths, int count);
+
 /**
  * uboot_eth_receive() - Receive an ethernet packet.
  *
+ * Where supported by the driver the buffer is loaned directly from the
+ * receive ring without copying. It may be processed in place (or handed on
+ * through shared memory) for as long as required, and remains valid until
+ * returned through uboot_eth_free_packet. The ring is refilled from a pool
+ * of spare buffers in the meantime; once all spare buffers are on loan no
+ * further packets are returned until a buffer is free'd.
+ *
  * @packet: pointer to the allocated buffer. The buffer must be free'd by
  *    calling uboot_eth_free_packet. Note this paramter is only valid
  *    when the return code is positive.
@@ -118,6 +271,297 @@ int uboot_eth_receive(unsigned char **packet);
  */
 int uboot_eth_free_packet(unsigned char **packet);
 
+/**
+ * uboot_eth_receive_burst() - Receive up to 'max' ethernet packets in a
+ *    single call.
+ *
+ * The device lookup and state checks are performed once for the whole
+ * burst, after which frames are drained from the driver's receive ring
+ * until it is empty or 'max' frames have been collected. Where the receive
+ * ring is not managed by the library at most one packet is returned per
+ * call, as the driver may reuse a single buffer for every frame.
+ *
+ * @packets: array of at least 'max' entries, filled with pointers to the
+ *    received buffers. The buffers must be free'd by calling
+ *    uboot_eth_free_packet_burst (or uboot_eth_free_packet individually).
+ * @lengths: array of at least 'max' entries, filled with the length of
+ *    each received packet.
+ * @max: the maximum number of packets to receive.
+ *
+ * Return: negative on error, otherwise the number of packets received.
+ */
+int uboot_eth_receive_burst(unsigned char **packets, int *lengths, int max);
+
+/**
+ * uboot_eth_free_packet_burst() - Frees a batch of packet buffers previously
+ *    returned by uboot_eth_receive_burst.
+ *
+ * @packets: array of pointers to the buffers to free.
+ * @count: the number of entries in the packets array.
+ *
+ * Return: 0 if OK, otherwise failure.
+ */
+int uboot_eth_free_packet_burst(unsigned char **packets, int count);
+
+/**
+ * uboot_eth_irq_enable() - Enable or disable the device interrupt.
+ *
+ * When enabled the device raises its interrupt on reception and on
+ * completion of transmission, delivered to the protection domain as a
+ * notification on the device's IRQ channel. The notification handler should
+ * call uboot_eth_irq_poll to drain the receive ring and reap transmit
+ * completions, and then acknowledge the IRQ through microkit_irq_ack.
+ *
+ * The interrupt remains enabled across uboot_eth_halt / uboot_eth_init.
+ *
+ * @enable: non-zero to enable the interrupt, zero to revert to polling.
+ *
+ * Return: 0 if OK, otherwise failure.
+ */
+int uboot_eth_irq_enable(int enable);
+
+/**
+ * uboot_eth_irq_poll() - Drain up to 'budget' received packets with the
+ *    receive interrupt masked.
+ *
+ * The interrupt is masked and acknowledged at the device before the ring is
+ * drained, and re-enabled only once the ring is empty. Packets may remain
+ * pending when the full budget is returned, or when every spare receive
+ * buffer is on loan (counted in rx_pool_empty); either way the interrupt
+ * stays masked and the caller should poll again, after servicing other work
+ * or freeing received packets, until the ring is drained. Frames arriving
+ * while masked are held in the ring for the next poll, but once the ring is
+ * full the device drops further frames, counting them in rx_overflow.
+ *
+ * Packets are returned exactly as by uboot_eth_receive_burst and must be
+ * free'd in the same way.
+ *
+ * @packets: array of at least 'budget' entries, filled with pointers to the
+ *    received buffers.
+ * @lengths: array of at least 'budget' entries, filled with the length of
+ *    each received packet.
+ * @budget: the maximum number of packets to receive.
+ *
+ * Return: negative on error, otherwise the number of packets received.
+ */
+int uboot_eth_irq_poll(unsigned char **packets, int *lengths, int budget);
+
+/**
+ * uboot_eth_set_coalescing() - Configure interrupt coalescing.
+ *
+ * An interrupt is raised once the given number of frames have completed, or
+ * the given time has elapsed since the first uncollected frame, whichever
+ * occurs first. Setting either threshold of a direction to zero disables
+ * coalescing for that direction, raising an interrupt for every frame. The
+ * time thresholds are converted using the rate of the device's system clock.
+ *
+ * @rx_frames: receive frame threshold, at most 255.
+ * @rx_usecs: receive time threshold in microseconds.
+ * @tx_frames: transmit frame threshold, at most 255.
+ * @tx_usecs: transmit time threshold in microseconds.
+ *
+ * Return: 0 if OK, otherwise failure.
+ */
+int uboot_eth_set_coalescing(unsigned int rx_frames, unsigned int rx_usecs,
+    unsigned int tx_frames, unsigned int tx_usecs);
+
+/**
+ * uboot_eth_alloc_tx_buffer() - Allocate a buffer for transmission.
+ *
+ * Frames sent by uboot_eth_send_async (or uboot_eth_send_burst) from a
+ * transmit buffer are handed to the device in place rather than copied onto
+ * the transmit ring. The caller retains ownership of the buffer and may
+ * reuse it for further frames once the transmission has completed.
+ *
+ * Return: a buffer of at least 1536 bytes, or NULL if none is available or
+ *    the driver does not support transmit buffers.
+ */
+unsigned char *uboot_eth_alloc_tx_buffer(void);
+
+/**
+ * uboot_eth_free_tx_buffer() - Return a buffer allocated through
+ *    uboot_eth_alloc_tx_buffer. It must not be awaiting transmission.
+ *
+ * @buffer: the buffer to free.
+ *
+ * Return: 0 if OK, -EBUSY if the buffer is awaiting transmission, -EINVAL
+ *    if it is not allocated, otherwise failure.
+ */
+int uboot_eth_free_tx_buffer(unsigned char *buffer);
+
+/**
+ * Callback invoked as each asynchronously sent frame completes, with the
+ * cookie given to uboot_eth_send_async.
+ */
+typedef void (*uboot_eth_tx_complete_t)(void *cookie);
+
+/**
+ * uboot_eth_set_tx_complete() - Set the transmit completion callback.
+ *
+ * @callback: the callback, or NULL to rely on uboot_eth_tx_completed alone.
+ */
+void uboot_eth_set_tx_complete(uboot_eth_tx_complete_t callback);
+
+/**
+ * uboot_eth_send_async() - Queue an ethernet packet for transmission.
+ *
+ * The call returns as soon as the packet has been queued on the transmit
+ * ring, without waiting for it to be sent. Completed transmissions are
+ * reaped in batches by later calls to uboot_eth_send_async, uboot_eth_tx_poll
+ * or uboot_eth_irq_poll (on a transmit interrupt), at which point the
+ * completion callback is invoked and the completed count advanced.
+ *
+ * Packets outside of a transmit buffer are copied, so their buffer may be
+ * reused as soon as the call returns; a transmit buffer must not be modified
+ * until the packet has completed. Where the driver does not support
+ * asynchronous transmission the packet is sent synchronously and completes
+ * before the call returns.
+ *
+ * @packet: the buffer to send.
+ * @length: the length of the buffer to send.
+ * @cookie: value passed to the completion callback for this packet.
+ *
+ * Return: 0 if queued, -EAGAIN if the transmit ring is full (call
+ *    uboot_eth_tx_poll and retry), otherwise failure.
+ */
+int uboot_eth_send_async(unsigned char *packet, int length, void *cookie);
+
+/**
+ * uboot_eth_tx_poll() - Reap completed transmissions.
+ *
+ * Return: negative on error, otherwise the number of packets completed.
+ */
+int uboot_eth_tx_poll(void);
+
+/**
+ * uboot_eth_tx_completed() - Return the number of packets whose
+ *    transmission has completed.
+ *
+ * Comparing this against the number of packets sent gives the number still
+ * in flight.
+ *
+ * Return: the count of completed packets.
+ */
+unsigned long uboot_eth_tx_completed(void);
+
+/**
+ * Counters of the ethernet rings, accumulated since the library was
+ * initialised.
+ *
+ * @rx_frames: packets received.
+ * @rx_errors: frames dropped as errored or too large for a buffer.
+ * @rx_pool_empty: number of times reception stalled as all spare buffers
+ *    were held by the client.
+ * @rx_overflow: frames dropped by the device as the receive ring was full.
+ * @tx_frames: packets queued for transmission.
+ * @tx_ring_full: number of sends which found the transmit ring full, each
+ *    counted once whether it then waited for space (uboot_eth_send) or
+ *    returned with packets not queued.
+ */
+struct uboot_eth_ring_stats {
+    unsigned long rx_frames;
+    unsigned long rx_errors;
+    unsigned long rx_pool_empty;
+    unsigned long rx_overflow;
+    unsigned long tx_frames;
+    unsigned long tx_ring_full;
+};
+
+/**
+ * uboot_eth_get_ring_stats() - Read the counters of the ethernet rings.
+ *
+ * @stats: filled with the current counters.
+ *
+ * Return: 0 if OK, otherwise failure (e.g. the driver does not support
+ *    ring management).
+ */
+int uboot_eth_get_ring_stats(struct uboot_eth_ring_stats *stats);
+
+/**
+ * Summary of a latency histogram. Percentiles are accurate to within a
+ * factor of two; the maximum is exact.
+ *
+ * @count: the number of samples.
+ * @p50_ns: median latency in nanoseconds.
+ * @p99_ns: 99th percentile latency in nanoseconds.
+ * @max_ns: largest latency in nanoseconds.
+ */
+struct uboot_eth_latency {
+    unsigned long count;
+    unsigned long p50_ns;
+    unsigned long p99_ns;
+    unsigned long max_ns;
+};
+
+/**
+ * Statistics of the ethernet packet path, accumulated since the library was
+ * initialised or uboot_eth_reset_stats was called.
+ *
+ * @rx_packets: packets received.
+ * @rx_bytes: bytes received.
+ * @rx_errors: packets dropped as errored, or receive calls which failed.
+ * @rx_dropped: packets dropped by the device as the receive ring was full.
+ * @tx_packets: packets sent (or queued for transmission).
+ * @tx_bytes: bytes sent (or queued for transmission).
+ * @tx_errors: send calls which failed.
+ * @tx_ring_full: number of sends which found the transmit ring full, each
+ *    counted once however long it waited.
+ * @tx_in_flight: packets currently queued awaiting transmission.
+ * @rx_held: received packets currently held by the client.
+ * @tx_latency: time from a packet being queued to its transmission being
+ *    found complete.
+ * @rx_hold: time from a received packet being returned to the client to it
+ *    being free'd.
+ *
+ * The ring occupancy and latencies are only available where the driver
+ * supports ring management; the latencies are only recorded while enabled
+ * through uboot_eth_enable_timestamps.
+ */
+struct uboot_eth_stats {
+    unsigned long rx_packets;
+    unsigned long rx_bytes;
+    unsigned long rx_errors;
+    unsigned long rx_dropped;
+    unsigned long tx_packets;
+    unsigned long tx_bytes;
+    unsigned long tx_errors;
+    unsigned long tx_ring_full;
+    unsigned int tx_in_flight;
+    unsigned int rx_held;
+    struct uboot_eth_latency tx_latency;
+    struct uboot_eth_latency rx_hold;
+};
+
+/**
+ * uboot_eth_get_stats() - Read the statistics of the ethernet packet path.
+ *
+ * @stats: filled with the current statistics.
+ *
+ * Return: 0 if OK, otherwise failure.
+ */
+int uboot_eth_get_stats(struct uboot_eth_stats *stats);
+
+/**
+ * uboot_eth_reset_stats() - Reset the statistics of the ethernet packet
+ *    path, including the latency histograms.
+ */
+void uboot_eth_reset_stats(void);
+
+/**
+ * uboot_eth_enable_timestamps() - Enable or disable per-packet timestamps.
+ *
+ * When enabled each packet is timestamped from the system counter as it is
+ * queued and received, and again as its transmission completes or it is
+ * free'd, building the latency histograms reported by uboot_eth_get_stats.
+ * This adds a read of the system counter per batch of packets, so is
+ * disabled by default.
+ *
+ * @enable: non-zero to enable timestamps.
+ *
+ * Return: 0 if OK, otherwise failure.
+ */
+int uboot_eth_enable_timestamps(int enable);
+
 /**
  * uboot_eth_get_ethaddr() - Return the MAC address.
  *
@@ -125,6 +569,598 @@ int uboot_eth_free_packet(unsigned char **packet);
  */
 unsigned char *uboot_eth_get_ethaddr(void);
 
+/**
+ * uboot_udp_bind() - Open a UDP socket bound to a local port.
+ *
+ * The UDP routines operate directly over the ethernet routines, without
+ * use of U-Boot's network commands, and take the local address from the
+ * 'ipaddr', 'netmask' and 'gatewayip' environment variables on first use.
+ * Destination addresses are resolved through ARP and cached. While in use
+ * they consume all received frames, discarding any that are not ARP or UDP
+ * for a bound port. Received datagrams are copied out of the frame, so no
+ * receive buffers are held; up to 32 datagrams are held across all sockets
+ * awaiting collection, and any beyond that are dropped. uboot_eth_init must
+ * have been called.
+ *
+ * @port: the local UDP port, in host byte order.
+ *
+ * Return: negative on error, otherwise the socket.
+ */
+int uboot_udp_bind(uint16_t port);
+
+/**
+ * uboot_udp_close() - Close a socket opened by uboot_udp_bind, discarding
+ *    any datagrams not yet received.
+ *
+ * @socket: the socket to close.
+ *
+ * Return: 0 if OK, otherwise failure.
+ */
+int uboot_udp_close(int socket);
+
+/**
+ * uboot_udp_sendto() - Send a UDP datagram.
+ *
+ * Blocks while the destination (or gateway) is resolved if it is not
+ * already known.
+ *
+ * @socket: the socket to send from.
+ * @data: the payload to send.
+ * @length: the length of the payload.
+ * @ip: the destination IPv4 address, in host byte order (e.g. 0xC0A80001
+ *    for 192.168.0.1).
+ * @port: the destination UDP port, in host byte order.
+ *
+ * Return: negative on error, otherwise the number of bytes sent.
+ */
+int uboot_udp_sendto(int socket, const void *data, int length, uint32_t ip,
+    uint16_t port);
+
+/**
+ * uboot_udp_recvfrom() - Receive a UDP datagram without blocking.
+ *
+ * @socket: the socket to receive on.
+ * @buffer: the buffer to receive the payload into. A payload longer than
+ *    the buffer is truncated.
+ * @length: the length of the buffer.
+ * @ip: if not NULL, set to the source IPv4 address in host byte order.
+ * @port: if not NULL, set to the source UDP port in host byte order.
+ *
+ * Return: negative on error, 0 if no datagram available, otherwise the
+ *    number of bytes received.
+ */
+int uboot_udp_recvfrom(int socket, void *buffer, int length, uint32_t *ip,
+    uint16_t *port);
+
+/**
+ * typedef uboot_tftp_callback_t - Receives each block of a TFTP transfer.
+ *
+ * @cookie: the cookie given in the request.
+ * @data: the data of the block.
+ * @offset: the offset of the block within the file.
+ * @length: the length of the block.
+ *
+ * Return: negative to abort the transfer, otherwise 0.
+ */
+typedef int (*uboot_tftp_callback_t)(void *cookie, const void *data,
+    unsigned long offset, int length);
+
+struct uboot_tftp_request {
+    uint32_t server_ip;             /* IPv4 address in host byte order */
+    uint16_t server_port;           /* 0 for the standard port */
+    const char *filename;
+    unsigned int blksize;           /* 0 for the default (1468) */
+    unsigned int windowsize;        /* 0 for the default (8) */
+    void *buffer;                   /* destination buffer, or NULL ... */
+    unsigned long buffer_size;
+    uboot_tftp_callback_t callback; /* ... to pass each block to 'callback' */
+    void *cookie;
+};
+
+struct uboot_tftp_stats {
+    unsigned long bytes;            /* bytes received */
+    unsigned long blocks;           /* blocks received in order */
+    unsigned int blksize;           /* negotiated block size */
+    unsigned int windowsize;        /* negotiated window size */
+    unsigned long retransmits;      /* requests / acknowledgements repeated */
+    unsigned long elapsed_us;       /* duration of the transfer */
+};
+
+/**
+ * uboot_tftp_get() - Download a file by TFTP.
+ *
+ * The transfer runs over the UDP routines (see uboot_udp_bind) rather than
+ * the 'tftp' command. Block size (RFC 2348) and window size (RFC 7440) are
+ * negotiated with the server, falling back to the defaults of a server
+ * without option support. The file is written directly into the given
+ * buffer (e.g. DMA memory) or passed to the callback block by block.
+ *
+ * @request: the server, file and destination of the transfer.
+ * @stats: if not NULL, filled with statistics of the transfer, including
+ *    its duration for measurement of throughput.
+ *
+ * Return: negative on error, otherwise the size of the file.
+ */
+long uboot_tftp_get(const struct uboot_tftp_request *request,
+    struct uboot_tftp_stats *stats);
+
+/**
+ * Configuration of a TFTP benchmark.
+ *
+ * @file_size: bytes served.
+ * @blksize: block size requested, 0 for the default.
+ * @windowsize: window size requested, 0 for the default.
+ * @loss_interval: drop every Nth data block sent, counting those resent,
+ *    or 0 to drop none.
+ */
+struct uboot_tftp_bench_config {
+    unsigned long file_size;
+    unsigned int blksize;
+    unsigned int windowsize;
+    unsigned int loss_interval;
+};
+
+/**
+ * Results of a TFTP benchmark.
+ *
+ * @stats: the statistics of the transfer, as from uboot_tftp_get.
+ * @dropped: the number of data blocks dropped.
+ * @kib_per_s: the throughput in KiB per second.
+ */
+struct uboot_tftp_bench_result {
+    struct uboot_tftp_stats stats;
+    unsigned long dropped;
+    unsigned long kib_per_s;
+};
+
+/**
+ * uboot_tftp_bench_run() - Measure the throughput of uboot_tftp_get against
+ *    a server stand-in.
+ *
+ * A loopback ethernet device temporarily replaces the current device and
+ * answers as a TFTP server would, so no network or server is needed. The
+ * server is given an address near 'ipaddr' (which must be set) on the same
+ * subnet, other than the subnet's network and broadcast addresses, and the
+ * address is removed from the neighbour cache after the run. The
+ * measurement covers the client and the UDP and ethernet routines beneath
+ * it, as well as the generation of each frame by the stand-in, but not a
+ * driver or the wire.
+ *
+ * Ethernet is halted before and after the run; call uboot_eth_init to
+ * resume use of the device.
+ *
+ * @config: the size of the file and the transfer options.
+ * @result: filled with the measurements.
+ *
+ * Return: 0 if OK, otherwise negative on failure.
+ */
+int uboot_tftp_bench_run(const struct uboot_tftp_bench_config *config,
+    struct uboot_tftp_bench_result *result);
+
+/* Opaque handle to an open block device */
+struct uboot_blk_handle;
+
+struct uboot_blk_info {
+    unsigned long block_size;       /* bytes per block */
+    unsigned long block_count;      /* size of the device in blocks */
+};
+
+/**
+ * uboot_blk_open() - Open a block device for use with the uboot_blk_xxx
+ *    routines.
+ *
+ * The device is resolved once here, so that subsequent reads and writes go
+ * directly to the block driver rather than through command parsing. An MMC
+ * device is initialised if necessary; USB devices must first have been
+ * enumerated by the 'usb start' command.
+ *
+ * @iface: the interface of the device, e.g. "mmc" or "usb".
+ * @devnum: the number of the device on that interface.
+ *
+ * Return: the handle if OK, otherwise NULL.
+ */
+struct uboot_blk_handle *uboot_blk_open(const char *iface, int devnum);
+
+/**
+ * uboot_blk_close() - Close a handle returned by uboot_blk_open, first
+ *    completing all queued requests and flushing any data held for the
+ *    device by the block cache.
+ *
+ * @handle: the handle to close.
+ */
+void uboot_blk_close(struct uboot_blk_handle *handle);
+
+/**
+ * uboot_blk_get_info() - Return the geometry of an open block device.
+ *
+ * @handle: the handle returned by uboot_blk_open.
+ * @info: filled with the block size and count of the device.
+ *
+ * Return: 0 if OK, otherwise failure.
+ */
+int uboot_blk_get_info(struct uboot_blk_handle *handle, struct uboot_blk_info *info);
+
+/**
+ * uboot_blk_read() - Read blocks from an open block device.
+ *
+ * @handle: the handle returned by uboot_blk_open.
+ * @lba: the first block to read.
+ * @count: the number of blocks to read.
+ * @buffer: the buffer to read into, of at least 'count' blocks.
+ *
+ * Return: negative on error, otherwise the number of blocks read.
+ */
+long uboot_blk_read(struct uboot_blk_handle *handle, unsigned long lba,
+    unsigned long count, void *buffer);
+
+/**
+ * uboot_blk_write() - Write blocks to an open block device.
+ *
+ * @handle: the handle returned by uboot_blk_open.
+ * @lba: the first block to write.
+ * @count: the number of blocks to write.
+ * @buffer: the data to write, of at least 'count' blocks.
+ *
+ * Return: negative on error, otherwise the number of blocks written.
+ */
+long uboot_blk_write(struct uboot_blk_handle *handle, unsigned long lba,
+    unsigned long count, const void *buffer);
+
+/**
+ * typedef uboot_blk_complete_t - Completes a request queued by
+ *    uboot_blk_submit.
+ *
+ * @cookie: the cookie given when the request was submitted.
+ * @result: negative on error, otherwise the number of blocks transferred.
+ */
+typedef void (*uboot_blk_complete_t)(void *cookie, long result);
+
+/**
+ * uboot_blk_submit() - Queue a read or write of an open block device.
+ *
+ * The request is performed by a later call of uboot_blk_poll, so that the
+ * caller can prepare further requests or attend to other work in between.
+ * Requests for consecutive blocks of a device are merged into a single
+ * transfer, even where their buffers are separate. The buffer must remain
+ * valid until the request completes.
+ *
+ * @handle: the handle returned by uboot_blk_open.
+ * @write: non-zero to write the blocks, otherwise they are read.
+ * @lba: the first block to transfer.
+ * @count: the number of blocks to transfer.
+ * @buffer: the buffer to transfer to or from, of at least 'count' blocks.
+ * @complete: if not NULL, called once the request is complete.
+ * @cookie: passed to 'complete'.
+ *
+ * Return: 0 if queued, -EAGAIN if the queue is full, otherwise failure.
+ */
+int uboot_blk_submit(struct uboot_blk_handle *handle, int write, unsigned long lba,
+    unsigned long count, void *buffer, uboot_blk_complete_t complete, void *cookie);
+
+/**
+ * uboot_blk_poll() - Perform queued block requests, in order of
+ *    submission, calling the completion of each. A completion may submit
+ *    further requests, or close a handle.
+ *
+ * @budget: the maximum number of transfers to perform, each of which may
+ *    serve several merged requests.
+ *
+ * Return: the number of requests completed.
+ */
+int uboot_blk_poll(int budget);
+
+/**
+ * uboot_blk_pending() - Return the number of queued block requests.
+ */
+int uboot_blk_pending(void);
+
+/* Opaque handle to an open file */
+struct uboot_fs_file;
+
+/* Origins of uboot_fs_seek */
+#define UBOOT_FS_SEEK_SET       0
+#define UBOOT_FS_SEEK_CUR       1
+#define UBOOT_FS_SEEK_END       2
+
+/**
+ * uboot_fs_open() - Open a file for reading with the uboot_fs_xxx routines.
+ *
+ * Unlike the 'load' commands, which read a whole file into one buffer, an
+ * open file is read in chunks into buffers supplied by the caller, so that
+ * processing can begin before the whole file has been read.
+ *
+ * The size of each file opened is remembered until the device is next
+ * written, so that reopening a file does not search its directory again.
+ *
+ * @iface: the interface of the device, e.g. "mmc" or "usb".
+ * @part: the device and partition, e.g. "0:1".
+ * @path: the path of the file within the filesystem.
+ *
+ * Return: the handle if OK, otherwise NULL.
+ */
+struct uboot_fs_file *uboot_fs_open(const char *iface, const char *part,
+    const char *path);
+
+/**
+ * uboot_fs_read() - Read from the current position of an open file,
+ *    advancing the position by the number of bytes read.
+ *
+ * @file: the handle returned by uboot_fs_open.
+ * @buffer: the buffer to read into.
+ * @length: the maximum number of bytes to read.
+ *
+ * Return: negative on error, 0 at the end of the file, otherwise the
+ *    number of bytes read.
+ */
+long uboot_fs_read(struct uboot_fs_file *file, void *buffer, unsigned long length);
+
+/**
+ * uboot_fs_seek() - Set the position of an open file.
+ *
+ * @file: the handle returned by uboot_fs_open.
+ * @offset: the offset of the position from 'whence'.
+ * @whence: UBOOT_FS_SEEK_SET, UBOOT_FS_SEEK_CUR or UBOOT_FS_SEEK_END.
+ *
+ * Return: negative on error, otherwise the new position.
+ */
+long long uboot_fs_seek(struct uboot_fs_file *file, long long offset, int whence);
+
+/**
+ * uboot_fs_size() - Return the size of an open file.
+ *
+ * @file: the handle returned by uboot_fs_open.
+ *
+ * Return: negative on error, otherwise the size of the file in bytes.
+ */
+long long uboot_fs_size(struct uboot_fs_file *file);
+
+/**
+ * uboot_fs_close() - Close a file opened by uboot_fs_open.
+ *
+ * @file: the handle to close.
+ */
+void uboot_fs_close(struct uboot_fs_file *file);
+
+struct uboot_blk_cache_config {
+    unsigned long line_size;        /* bytes per line, a multiple of 4K */
+    unsigned int lines;             /* lines held, 0 to disable the cache */
+    unsigned long readahead_max;    /* largest read ahead in bytes */
+    int write_back;                 /* non-zero to hold writes until flushed */
+};
+
+/**
+ * uboot_blk_flush() - Write any data held by the block cache to the device,
+ *    acting as a barrier: all writes made before the call have reached the
+ *    device once it returns successfully.
+ *
+ * @handle: the handle returned by uboot_blk_open, or NULL to flush all
+ *    devices.
+ *
+ * Return: 0 if OK, otherwise failure.
+ */
+int uboot_blk_flush(struct uboot_blk_handle *handle);
+
+/**
+ * uboot_blk_cache_configure() - Configure the block cache.
+ *
+ * All block devices are read through a cache of fixed size lines held in
+ * DMA memory. Sequential reads are detected and read ahead in runs of up to
+ * 'readahead_max' bytes, while requests at least that large bypass the
+ * cache. By default 64 lines of 16K are cached, reading ahead up to 256K.
+ *
+ * Writes pass through to the device unless 'write_back' is set. Writes
+ * smaller than 'readahead_max' then only update the cache, and are written
+ * to the device when evicted or flushed by uboot_blk_flush, with adjacent
+ * blocks combined into a single write. Data written is lost if not flushed
+ * before power is removed.
+ *
+ * Reconfiguration flushes and then discards the contents of the cache.
+ *
+ * @config: the configuration, or NULL to restore the defaults.
+ *
+ * Return: 0 if OK, otherwise failure.
+ */
+int uboot_blk_cache_configure(const struct uboot_blk_cache_config *config);
+
+struct uboot_blk_cache_stats {
+    unsigned long hits;             /* lines found in the cache */
+    unsigned long misses;           /* lines read on demand */
+    unsigned long prefetched;       /* lines read ahead of demand */
+    unsigned long bypassed;         /* requests read directly */
+    unsigned long device_reads;     /* read commands issued to devices */
+    unsigned long deferred_writes;  /* write requests held in the cache */
+    unsigned long device_writes;    /* write commands issued to devices */
+    unsigned long dirty_lines;      /* lines holding unwritten data */
+};
+
+/**
+ * uboot_blk_cache_get_stats() - Read the counters of the block cache.
+ *
+ * @stats: filled with the counters.
+ *
+ * Return: 0 if OK, otherwise failure.
+ */
+int uboot_blk_cache_get_stats(struct uboot_blk_cache_stats *stats);
+
+/**
+ * uboot_blk_cache_reset_stats() - Reset the counters of the block cache.
+ */
+void uboot_blk_cache_reset_stats(void);
+
+/**
+ * uboot_usb_storage_set_max_transfer() - Set the largest read issued to a
+ *    USB mass storage device in a single command.
+ *
+ * By default reads of up to 1MB (SuperSpeed) or 512KB (otherwise) are
+ * issued as one command, rather than the 120KB of U-Boot's usb_storage
+ * driver. A device failing a command has its maximum halved and the read
+ * retried, down to the driver's own limit.
+ *
+ * @blocks: the maximum in blocks, 0 for the default, or at most 240 to
+ *    leave all reads to the usb_storage driver.
+ *
+ * Return: 0 if OK, otherwise failure.
+ */
+int uboot_usb_storage_set_max_transfer(unsigned long blocks);
+
+/**
+ * uboot_ramdisk_create() - Create a block device held in memory.
+ *
+ * The device is bound to the "host" interface and may be used wherever an
+ * SD card or USB drive could be, e.g. with uboot_blk_open("host", devnum)
+ * or by the U-Boot commands as "host <devnum>". Its contents are initially
+ * zero and are lost when it is destroyed.
+ *
+ * @block_size: bytes per block, a power of two from 512 to 4096.
+ * @block_count: size of the device in blocks.
+ *
+ * Return: the device number if OK, otherwise negative on failure.
+ */
+int uboot_ramdisk_create(unsigned long block_size, unsigned long block_count);
+
+/**
+ * uboot_ramdisk_destroy() - Remove a device created by uboot_ramdisk_create
+ *    and free its memory. Any handle or file open on the device must first be
+ *    closed.
+ *
+ * @devnum: the device number returned by uboot_ramdisk_create.
+ *
+ * Return: 0 if OK, otherwise failure.
+ */
+int uboot_ramdisk_destroy(int devnum);
+
+#define UBOOT_BLK_BENCH_SEQ_READ    0
+#define UBOOT_BLK_BENCH_SEQ_WRITE   1
+#define UBOOT_BLK_BENCH_RAND_READ   2
+#define UBOOT_BLK_BENCH_RAND_WRITE  3
+
+/**
+ * Configuration of a block layer benchmark.
+ *
+ * @iface: the interface of the device, e.g. "mmc", "usb" or "host".
+ * @devnum: the number of the device, for raw blocks.
+ * @part: the device and partition, e.g. "0:1", for a file.
+ * @path: the file to read or write, or NULL to use raw blocks.
+ * @workload: one of UBOOT_BLK_BENCH_xxx.
+ * @io_size: bytes per operation, a multiple of the block size for raw
+ *    blocks.
+ * @total: bytes to transfer, rounded up to whole operations.
+ * @lba_start: the first block of the region used, for raw blocks.
+ * @lba_count: the size of the region in blocks; must be given for writes,
+ *    otherwise zero uses the whole device.
+ * @seed: seed of the random offsets, zero for a fixed default.
+ *
+ * Random offsets are aligned to the operation size. A file read must exist;
+ * a sequential write replaces the file and a random write overwrites its
+ * existing contents. Writing at an offset is not supported by ext4, so file
+ * writes require a FAT filesystem.
+ */
+struct uboot_blk_bench_config {
+    const char *iface;
+    int devnum;
+    const char *part;
+    const char *path;
+    int workload;
+    unsigned long io_size;
+    unsigned long long total;
+    unsigned long lba_start;
+    unsigned long lba_count;
+    unsigned int seed;
+};
+
+/**
+ * Results of a block layer benchmark. Percentiles are accurate to within a
+ * factor of two; the maximum is exact.
+ *
+ * @operations: the number of reads or writes.
+ * @bytes: the number of bytes transferred.
+ * @elapsed_us: the duration of the run, including any flush of written data
+ *    held by the block cache.
+ * @kib_per_s: the throughput in KiB per second.
+ * @p50_ns: median latency of an operation in nanoseconds.
+ * @p90_ns: 90th percentile latency in nanoseconds.
+ * @p99_ns: 99th percentile latency in nanoseconds.
+ * @max_ns: largest latency in nanoseconds.
+ */
+struct uboot_blk_bench_result {
+    unsigned long operations;
+    unsigned long long bytes;
+    unsigned long elapsed_us;
+    unsigned long kib_per_s;
+    unsigned long p50_ns;
+    unsigned long p90_ns;
+    unsigned long p99_ns;
+    unsigned long max_ns;
+};
+
+/**
+ * uboot_blk_bench_run() - Measure the throughput and latency of the block
+ *    layer for one workload.
+ *
+ * Transfers pass through the block cache as for any other user; configure
+ * or disable it through uboot_blk_cache_configure to compare.
+ *
+ * @config: the device or file, and the workload to run.
+ * @result: filled with the measurements.
+ *
+ * Return: 0 if OK, otherwise negative on failure.
+ */
+int uboot_blk_bench_run(const struct uboot_blk_bench_config *config,
+    struct uboot_blk_bench_result *result);
+
+/* Formats of a file loaded by uboot_fs_load */
+#define UBOOT_FS_CODEC_AUTO     0
+#define UBOOT_FS_CODEC_NONE     1
+#define UBOOT_FS_CODEC_LZ4      2
+#define UBOOT_FS_CODEC_GZIP     3
+
+/**
+ * Measurements of a file loaded by uboot_fs_load.
+ *
+ * @codec: the format of the file, one of UBOOT_FS_CODEC_xxx other than
+ *    AUTO.
+ * @file_bytes: the number of bytes read from the file.
+ * @loaded_bytes: the number of bytes written to the buffer.
+ * @read_us: time spent reading the file.
+ * @decompress_us: time spent decompressing, including any check of the
+ *    decompressed data.
+ * @elapsed_us: the duration of the whole load.
+ */
+struct uboot_fs_load_stats {
+    int codec;
+    unsigned long long file_bytes;
+    unsigned long long loaded_bytes;
+    unsigned long read_us;
+    unsigned long decompress_us;
+    unsigned long elapsed_us;
+};
+
+/**
+ * uboot_fs_load() - Load a file into memory, decompressing it as it is read.
+ *
+ * The file is read in chunks and each chunk decompressed into the buffer
+ * before the next is read, so only a chunk of the compressed file is held
+ * at any time. LZ4 files must be in the LZ4 frame format (as written by the
+ * 'lz4' tool) without a dictionary; their checksums are not verified. The
+ * CRC of gzip files is verified. An uncompressed file is read into the
+ * buffer in the same way as by the 'load' commands.
+ *
+ * @iface: the interface of the device, e.g. "mmc" or "usb".
+ * @part: the device and partition, e.g. "0:1".
+ * @path: the path of the file within the filesystem.
+ * @codec: the format of the file, or UBOOT_FS_CODEC_AUTO to recognise it
+ *    from its contents.
+ * @buffer: the buffer to load into.
+ * @buffer_size: the size of the buffer in bytes.
+ * @stats: filled with measurements of the load, or NULL.
+ *
+ * Return: negative on error (-EFBIG if the buffer is too small, -EPROTO if
+ *    the file is corrupt or not of the format given), otherwise the number
+ *    of bytes loaded.
+ */
+long uboot_fs_load(const char *iface, const char *part, const char *path, int codec,
+    void *buffer, unsigned long buffer_size, struct uboot_fs_load_stats *stats);
+
 /**
  * shutdown_uboot_drivers() - shutdown the u-boot driver library.
  */
@@ -0,0 +1,30 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ */
+
+#ifndef __FEC_LINK_H
+#define __FEC_LINK_H
+
+/* Routines to inspect the link state of the fec_mxc PHY without blocking.
+ *
+ * Starting the driver waits for any autonegotiation in progress to complete,
+ * which may take several seconds. By checking the PHY directly the wrapper
+ * can defer starting the driver until the link is up, at which point the
+ * driver's startup completes without waiting.
+ */
+
+struct udevice;
+
+/* Link state as reported by 'fec_link_check' */
+#define FEC_LINK_DOWN           0
+#define FEC_LINK_NEGOTIATING    1
+#define FEC_LINK_UP             2
+
+int fec_link_check(struct udevice *dev);
+
+int fec_link_autoneg(struct udevice *dev);
+
+#endif /* __FEC_LINK_H */
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ */
+
+#ifndef __FEC_RING_H
+#define __FEC_RING_H
+
+/* Routines providing direct management of the fec_mxc descriptor rings.
+ *
+ * Once the driver has been started through eth_init, 'fec_ring_attach' takes
+ * ownership of the descriptor rings from the driver. Frames can then be
+ * queued in batches with a single write to the transmit doorbell, and
+ * completed descriptors are reclaimed lazily on later calls rather than by
+ * waiting for each frame to leave the wire. Frames held in buffers of the
+ * transmit pool ('fec_ring_alloc_tx_buffer') are sent without copying, and
+ * the optional completion callback reports when each may be reused.
+ *
+ * The ring depths and buffer size may be set through 'fec_ring_configure'
+ * before attaching.
+ *
+ * Received frames are returned as buffers loaned directly from the receive
+ * ring; each must be returned through 'fec_ring_free_packet'.
+ *
+ * Any restart of the device by the U-Boot network stack (e.g. through a
+ * 'ping' or 'tftp' command) returns ownership of the rings to the driver;
+ * 'fec_ring_resync' detects this and re-attaches.
+ *
+ * In interrupt mode 'fec_ring_irq_poll' drains the receive ring with the
+ * controller's interrupt masked, re-enabling it only once fewer frames than
+ * the given budget remain.
+ */
+
+struct udevice;
+struct uboot_latency;
+
+/* Depth of each ring and size of each buffer. Zero selects the default. */
+struct fec_ring_config {
+    /* Number of receive descriptors, and additional buffers which may be
+     * loaned to the client */
+    unsigned int rx_size;
+    unsigned int rx_spare;
+    /* Number of transmit descriptors, and transmit buffers for the client */
+    unsigned int tx_size;
+    unsigned int tx_pool;
+    /* Size of each buffer; larger frames are dropped */
+    unsigned int buf_size;
+};
+
+struct fec_ring_stats {
+    /* Frames and bytes received, and frames dropped for errors or being too
+     * large */
+    unsigned long rx_frames;
+    unsigned long rx_bytes;
+    unsigned long rx_errors;
+    /* Times reception stalled with all spare buffers on loan */
+    unsigned long rx_pool_empty;
+    /* Frames lost by the controller for want of a free descriptor */
+    unsigned long rx_overflow;
+    /* Frames and bytes queued for transmission, and sends which found the
+     * ring full (once per send, however long it waited) */
+    unsigned long tx_frames;
+    unsigned long tx_bytes;
+    unsigned long tx_ring_full;
+    /* Current occupancy: frames awaiting transmission, and received buffers
+     * held by the client */
+    unsigned int tx_in_flight;
+    unsigned int rx_held;
+};
+
+typedef void (*fec_ring_tx_complete_t)(void *cookie);
+
+int fec_ring_configure(const struct fec_ring_config *config);
+
+int fec_ring_attach(struct udevice *dev);
+
+void fec_ring_detach(void);
+
+void fec_ring_resync(struct udevice *dev);
+
+void fec_ring_shutdown(void);
+
+bool fec_ring_attached(void);
+
+int fec_ring_send(unsigned char *packet, int length);
+
+int fec_ring_send_burst(unsigned char **packets, int *lengths, int count);
+
+int fec_ring_send_async(unsigned char *packet, int length, void *cookie);
+
+int fec_ring_tx_reclaim(void);
+
+bool fec_ring_is_tx_buffer(unsigned char *buffer);
+
+unsigned char *fec_ring_alloc_tx_buffer(void);
+
+int fec_ring_free_tx_buffer(unsigned char *buffer);
+
+void fec_ring_set_tx_complete(fec_ring_tx_complete_t callback);
+
+unsigned long fec_ring_tx_completed(void);
+
+int fec_ring_receive_burst(unsigned char **packets, int *lengths, int max);
+
+bool fec_ring_is_packet(unsigned char *packet);
+
+int fec_ring_free_packet(unsigned char *packet);
+
+int fec_ring_irq_enable(bool enable);
+
+int fec_ring_irq_poll(unsigned char **packets, int *lengths, int budget);
+
+int fec_ring_set_coalescing(unsigned int rx_frames, unsigned int rx_usecs,
+    unsigned int tx_frames, unsigned int tx_usecs);
+
+void fec_ring_get_stats(struct fec_ring_stats *stats);
+
+void fec_ring_reset_stats(void);
+
+void fec_ring_enable_timestamps(bool enable);
+
+void fec_ring_get_latency(struct uboot_latency *tx_latency, struct uboot_latency *rx_hold);
+
+#endif /* __FEC_RING_H */
@@ -5,6 +5,9 @@
  *
  */
 
+#ifndef __SEL4_DMA_H
+#define __SEL4_DMA_H
+
 #include <linux/types.h>
 #include <linux/dma-direction.h>
 
@@ -16,6 +19,11 @@ void sel4_dma_free(void *vaddr);
 
 void* sel4_dma_memalign(size_t align, size_t size);
 
+/* Allocate from the uncached DMA pool, for structures such as descriptor
+ * rings that are shared with a device at a finer granularity than a cache
+ * line. Fails unless the system provides an uncached pool. */
+void* sel4_dma_memalign_uncached(size_t align, size_t size);
+
 void* sel4_dma_malloc(size_t size);
 
 void* sel4_dma_virt_to_phys(void *vaddr);
@@ -28,4 +36,50 @@ bool sel4_dma_is_mapped(void *vaddr);
 
 void* sel4_dma_map_single(void* public_vaddr, size_t size, enum dma_data_direction dir);
 
-void sel4_dma_unmap_single(void *paddr);
\ No newline at end of file
+void sel4_dma_unmap_single(void *paddr);
+
+/* Pools of fixed size DMA objects.
+ *
+ * A pool is backed by a single DMA allocation, carved into objects each
+ * aligned to a cache line, so that large numbers of buffers (e.g. for deep
+ * descriptor rings) consume only one of the limited DMA allocation slots and
+ * their physical addresses can be calculated without a search. */
+
+struct sel4_dma_pool {
+    uint8_t *base;
+    uintptr_t paddr;
+    size_t object_size;
+    unsigned int count;
+    /* Stack of the indices of free objects */
+    unsigned int *free;
+    unsigned int free_count;
+    /* Bitmap of the objects allocated, by which a double free is detected */
+    unsigned long *allocated;
+};
+
+int sel4_dma_pool_create(struct sel4_dma_pool *pool, size_t object_size, unsigned int count);
+
+void sel4_dma_pool_destroy(struct sel4_dma_pool *pool);
+
+void* sel4_dma_pool_alloc(struct sel4_dma_pool *pool);
+
+int sel4_dma_pool_free(struct sel4_dma_pool *pool, void *object);
+
+bool sel4_dma_pool_contains(struct sel4_dma_pool *pool, void *vaddr);
+
+static inline void* sel4_dma_pool_object(struct sel4_dma_pool *pool, unsigned int index)
+{
+    return pool->base + index * pool->object_size;
+}
+
+static inline unsigned int sel4_dma_pool_index(struct sel4_dma_pool *pool, void *object)
+{
+    return ((uint8_t *) object - pool->base) / pool->object_size;
+}
+
+static inline uintptr_t sel4_dma_pool_paddr(struct sel4_dma_pool *pool, void *vaddr)
+{
+    return pool->paddr + ((uint8_t *) vaddr - pool->base);
+}
+
+#endif /* __SEL4_DMA_H */
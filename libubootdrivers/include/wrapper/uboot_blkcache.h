@@ -0,0 +1,56 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ */
+
+#ifndef __UBOOT_BLKCACHE_H
+#define __UBOOT_BLKCACHE_H
+
+/* Routines providing a read-ahead cache of block device contents, shared by
+ * the filesystems, the U-Boot commands and the wrapper's block routines.
+ *
+ * Filesystems read a few blocks at a time, each read becoming a separate
+ * command to the card or USB device. 'uboot_blkcache_interpose' wraps the
+ * operations of the block drivers so that reads are satisfied from fixed
+ * size cache lines held in DMA memory, and sequential reads are detected and
+ * satisfied by reading ahead several lines in a single command. Writes pass
+ * through to the device, updating any cached copy, or if write-back is
+ * configured are held in the cache until evicted or flushed by
+ * 'uboot_blkcache_flush'.
+ *
+ * 'uboot_blkcache_pin' keeps a region of a device (e.g. the allocation table
+ * of a filesystem) in the cache once read, and 'uboot_blkcache_generation'
+ * changes with every write, allowing information derived from the contents
+ * of a device to be discarded once stale. 'uboot_blkcache_remove' forgets
+ * a device about to be removed, discarding anything not yet written. The
+ * remove method of each wrapped driver is also wrapped, so that a device
+ * removed by U-Boot is first flushed and then forgotten.
+ *
+ * The cache identifies a device only by its 'struct udevice', which may hold
+ * a different medium, or be reused for a different device, once a U-Boot
+ * command has run. The cache is therefore flushed before and after each
+ * command, and 'uboot_blkcache_invalidate' then called, discarding all
+ * lines and pins and changing the generation.
+ */
+
+#include <blk.h>
+
+struct udevice;
+
+void uboot_blkcache_interpose(void);
+
+int uboot_blkcache_flush(struct udevice *dev);
+
+int uboot_blkcache_pin(struct udevice *dev, lbaint_t start, lbaint_t count);
+
+void uboot_blkcache_remove(struct udevice *dev);
+
+unsigned long uboot_blkcache_generation(void);
+
+void uboot_blkcache_invalidate(void);
+
+void uboot_blkcache_shutdown(void);
+
+#endif /* __UBOOT_BLKCACHE_H */
@@ -0,0 +1,23 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ */
+
+#ifndef __UBOOT_ETH_H
+#define __UBOOT_ETH_H
+
+/* Ethernet routines of the public API (see uboot_drivers.h) used by other
+ * parts of the wrapper which build upon them.
+ */
+
+int uboot_eth_send(unsigned char *packet, int length);
+
+int uboot_eth_receive_burst(unsigned char **packets, int *lengths, int max);
+
+int uboot_eth_free_packet(unsigned char **packet);
+
+unsigned char *uboot_eth_get_ethaddr(void);
+
+#endif /* __UBOOT_ETH_H */
@@ -0,0 +1,22 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ */
+
+#ifndef __UBOOT_FS_H
+#define __UBOOT_FS_H
+
+/* Routines supporting the wrapper's streaming file access.
+ *
+ * An ext4 file read through the uboot_fs_xxx routines is held open in
+ * U-Boot's ext4 driver between reads, so that its inode is not looked up
+ * again for each chunk. The driver has room for a single open file, so
+ * 'uboot_fs_release' must close it before anything else uses the
+ * filesystems, such as a U-Boot command.
+ */
+
+void uboot_fs_release(void);
+
+#endif /* __UBOOT_FS_H */
@@ -0,0 +1,34 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ */
+
+#ifndef __UBOOT_LATENCY_H
+#define __UBOOT_LATENCY_H
+
+/* Histograms of latencies measured in ticks of the system counter.
+ *
+ * Samples are counted in power of two buckets, so recording a sample is
+ * cheap enough for the packet path. Percentiles are reported as the upper
+ * bound of the bucket holding them, i.e. to within a factor of two, and the
+ * maximum exactly.
+ */
+
+/* One bucket per bit length of a 64 bit sample, plus one for zero */
+#define UBOOT_LATENCY_BUCKETS   65
+
+struct uboot_latency {
+    unsigned long count;
+    uint64_t max;
+    unsigned long buckets[UBOOT_LATENCY_BUCKETS];
+};
+
+void uboot_latency_record(struct uboot_latency *latency, uint64_t ticks);
+
+uint64_t uboot_latency_percentile(const struct uboot_latency *latency, unsigned int percent);
+
+unsigned long uboot_latency_ticks_to_ns(uint64_t ticks);
+
+#endif /* __UBOOT_LATENCY_H */
@@ -0,0 +1,40 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ */
+
+#ifndef __UBOOT_NEIGH_H
+#define __UBOOT_NEIGH_H
+
+#include <net.h>
+
+/* Routines providing a cache of resolved IPv4 neighbours, shared by the
+ * U-Boot network commands and the wrapper's own UDP routines.
+ *
+ * U-Boot's ARP implementation resolves a single address per command and
+ * forgets it afterwards. 'uboot_neigh_interpose' wraps the operations of the
+ * ethernet driver so that ARP traffic exchanged by the U-Boot commands is
+ * learnt, and an ARP request for a cached address is answered locally
+ * rather than being sent to the network.
+ *
+ * 'uboot_neigh_announce' applies an ARP reply or gratuitous ARP, returning
+ * whether the packet was one: the sender's hardware address replaces any
+ * cached for it, unless the frame's source differs from the sender hardware
+ * address or that is not unicast, in which case the entry is forgotten.
+ */
+
+void uboot_neigh_interpose(void);
+
+bool uboot_neigh_lookup(struct in_addr ip, u8 *ethaddr);
+
+void uboot_neigh_update(struct in_addr ip, const u8 *ethaddr);
+
+void uboot_neigh_forget(struct in_addr ip);
+
+bool uboot_neigh_announce(struct ethernet_hdr *et, struct arp_hdr *arp);
+
+void uboot_neigh_flush(void);
+
+#endif /* __UBOOT_NEIGH_H */
@@ -0,0 +1,25 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ */
+
+#ifndef __UBOOT_UDP_H
+#define __UBOOT_UDP_H
+
+/* UDP routines of the public API (see uboot_drivers.h) used by other parts
+ * of the wrapper which build upon them.
+ */
+
+int uboot_udp_bind(uint16_t port);
+
+int uboot_udp_close(int socket);
+
+int uboot_udp_sendto(int socket, const void *data, int length, uint32_t ip,
+    uint16_t port);
+
+int uboot_udp_recvfrom(int socket, void *buffer, int length, uint32_t *ip,
+    uint16_t *port);
+
+#endif /* __UBOOT_UDP_H */
@@ -0,0 +1,27 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ */
+
+#ifndef __UBOOT_USBSTOR_H
+#define __UBOOT_USBSTOR_H
+
+/* Routines issuing large reads to USB mass storage devices.
+ *
+ * 'uboot_usbstor_interpose' wraps the read operation of the usb_storage
+ * driver, so that reads larger than the driver issues in a single command
+ * are sent as fewer, larger Bulk-Only Transport commands. It must precede
+ * 'uboot_blkcache_interpose', so that the block cache reads through it.
+ *
+ * The interface and transfer size found for each device are forgotten by
+ * 'uboot_usbstor_forget', as needed whenever the USB bus may have been
+ * enumerated again.
+ */
+
+void uboot_usbstor_interpose(void);
+
+void uboot_usbstor_forget(void);
+
+#endif /* __UBOOT_USBSTOR_H */
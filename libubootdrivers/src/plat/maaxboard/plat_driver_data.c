@@ -70,6 +70,8 @@ void initialise_driver_data(void) {
     driver_data.driver_array[30] = _u_boot_driver__clk_fixed_rate_raw;
     driver_data.driver_array[31] = _u_boot_driver__clk_gate;
     driver_data.driver_array[32] = _u_boot_driver__ccf_clk_mux;
+    driver_data.driver_array[33] = _u_boot_driver__uboot_ramdisk_blk;
+    driver_data.driver_array[34] = _u_boot_driver__uboot_tftp_loopback_eth;
 
     driver_data.usb_driver_entry_array[0] = _u_boot_usb_driver_entry__usb_generic_hub;
     driver_data.usb_driver_entry_array[1] = _u_boot_usb_driver_entry__usb_mass_storage;
@@ -32,6 +32,7 @@ void initialise_driver_data(void) {
     driver_data.driver_array[4]  = _u_boot_driver__meson_gx_gpio_driver;
     driver_data.driver_array[5]  = _u_boot_driver__led_gpio_wrap;
     driver_data.driver_array[6]  = _u_boot_driver__led_gpio;
+    driver_data.driver_array[7]  = _u_boot_driver__uboot_ramdisk_blk;
 
     driver_data.cmd_array[0]  = _u_boot_cmd__dm;
     driver_data.cmd_array[1]  = _u_boot_cmd__env;
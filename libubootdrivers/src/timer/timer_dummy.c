@@ -17,6 +17,10 @@ uint64_t get_ticks(void) {
     assert(false);
 }
 
+unsigned long get_tbclk(void) {
+    assert(false);
+}
+
 unsigned long timer_get_us(void) {
     assert(false);
 }
@@ -73,6 +73,10 @@ uint64_t get_ticks(void) {
     return (((u64)high << 32) | low);
 }
 
+unsigned long get_tbclk(void) {
+    return tick_frequency;
+}
+
 unsigned long timer_get_us(void) {
     /* To improve accuracy we shift ticks left by 7 bits. Note that
     * the counter value is only a 57 bit value so this is safe.
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This file provides non-blocking checks of the link state of the PHY
+ * attached to the fec_mxc Ethernet controller.
+ */
+
+#include <uboot_helper.h>
+#include <dm/device.h>
+#include <net.h>
+#include <phy.h>
+#include <linux/mii.h>
+#include <fec_link.h>
+#include "../../uboot/drivers/net/fec_mxc.h"
+
+static struct phy_device *fec_link_phydev(struct udevice *dev)
+{
+    struct fec_priv *fec;
+
+    if (dev == NULL || device_get_uclass_id(dev) != UCLASS_ETH)
+        return NULL;
+
+    fec = dev_get_priv(dev);
+
+    return (fec != NULL) ? fec->phydev : NULL;
+}
+
+int fec_link_check(struct udevice *dev)
+{
+    struct phy_device *phydev = fec_link_phydev(dev);
+    int bmsr;
+
+    if (phydev == NULL)
+        return -ENODEV;
+
+    // A fixed link, or a PHY without autonegotiation, is up as configured.
+    if (phydev->autoneg != AUTONEG_ENABLE)
+        return FEC_LINK_UP;
+
+    // The link status bit latches low; the first read reports any loss of
+    // link since it was last read, the second the current state.
+    phy_read(phydev, MDIO_DEVAD_NONE, MII_BMSR);
+    bmsr = phy_read(phydev, MDIO_DEVAD_NONE, MII_BMSR);
+    if (bmsr < 0)
+        return bmsr;
+
+    if ((bmsr & BMSR_ANEGCOMPLETE) && (bmsr & BMSR_LSTATUS))
+        return FEC_LINK_UP;
+
+    return (bmsr & BMSR_ANEGCOMPLETE) ? FEC_LINK_DOWN : FEC_LINK_NEGOTIATING;
+}
+
+int fec_link_autoneg(struct udevice *dev)
+{
+    struct phy_device *phydev = fec_link_phydev(dev);
+    int bmcr;
+
+    if (phydev == NULL)
+        return -ENODEV;
+
+    if (phydev->autoneg != AUTONEG_ENABLE)
+        return 0;
+
+    // Only (re)start negotiation if it is not already enabled; restarting
+    // a negotiation in progress, or one which has completed with the
+    // parameters already advertised, would only delay the link.
+    bmcr = phy_read(phydev, MDIO_DEVAD_NONE, MII_BMCR);
+    if (bmcr < 0)
+        return bmcr;
+
+    if ((bmcr & BMCR_ANENABLE) && !(bmcr & BMCR_ISOLATE))
+        return 0;
+
+    bmcr |= BMCR_ANENABLE | BMCR_ANRESTART;
+    bmcr &= ~BMCR_ISOLATE;
+
+    return phy_write(phydev, MDIO_DEVAD_NONE, MII_BMCR, bmcr);
+}
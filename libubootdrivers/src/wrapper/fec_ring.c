@@ -0,0 +1,927 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This file provides direct management of the descriptor rings of the
+ * fec_mxc Ethernet controller, allowing the wrapper to queue frames in
+ * batches rather than one synchronous transfer at a time, and to loan
+ * received buffers to the client without copying them.
+ *
+ * The descriptors live in uncached DMA memory. The controller writes back
+ * to each descriptor once it has finished with it, and as several
+ * descriptors share a cache line, cleaning a cached line to hand over one
+ * descriptor could overwrite the controller's update of a neighbour. With
+ * the rings uncached each descriptor is written on its own as soon as it is
+ * free, so frames are queued and buffers re-armed one at a time. The system
+ * must therefore provide an uncached DMA pool; without one the rings are
+ * not attached and the driver's own synchronous path is used.
+ *
+ * The depth of each ring and the size of the buffers are configurable
+ * ('fec_ring_configure'), up to rings of several thousand descriptors. All
+ * buffers of a kind are drawn from a single DMA object pool, so deep rings
+ * do not exhaust the DMA allocations available to the rest of the library.
+ *
+ * Receive buffers are drawn from a pool larger than the receive ring. When
+ * a frame is handed to the client its descriptor is immediately given a
+ * spare buffer from the pool, so the ring is not starved while the client
+ * holds on to buffers.
+ *
+ * Transmission is asynchronous: frames are queued and the call returns,
+ * with completed descriptors reclaimed on later calls. Frames sent from
+ * buffers of the transmit pool are given to the controller in place, the
+ * client being told through a completion callback and counter when each
+ * buffer may be reused.
+ *
+ * Counters are kept of the traffic through the rings. Optionally each frame
+ * is also timestamped from the system counter, giving histograms of the
+ * time from queueing to completion of transmitted frames and of the time
+ * received buffers are held by the client.
+ *
+ * Reception may optionally be interrupt driven. The interrupt is masked at
+ * the controller for as long as frames remain to be drained, so a client
+ * under load polls the ring rather than taking an interrupt per frame.
+ */
+
+#include <uboot_helper.h>
+#include <dm/device.h>
+#include <net.h>
+#include <cpu_func.h>
+#include <asm/io.h>
+#include <clk.h>
+#include <fec_ring.h>
+#include <uboot_latency.h>
+
+#include "../../uboot/drivers/net/fec_mxc.h"
+
+/* Default number of transmit descriptors managed by the wrapper */
+#define FEC_RING_TX_SIZE        32
+
+/* Default number of buffers in the pool available to the client for
+ * transmission without copying */
+#define FEC_RING_TX_POOL        64
+
+/* Default number of receive descriptors, and the number of additional
+ * receive buffers available to be loaned to the client */
+#define FEC_RING_RX_SIZE        32
+#define FEC_RING_RX_SPARE       32
+
+/* Smallest and largest ring supported; buffer indices are held in 16 bits */
+#define FEC_RING_MIN_SIZE       2
+#define FEC_RING_MAX_SIZE       4096
+
+/* Default (and largest) size of each DMA buffer attached to a descriptor,
+ * and the smallest size supported */
+#define FEC_RING_BUF_SIZE       roundup(FEC_MAX_PKT_SIZE, CONFIG_SYS_CACHELINE_SIZE)
+#define FEC_RING_MIN_BUF_SIZE   256
+
+/* Statistics registers: MIB control, and the count of frames lost to receive
+ * FIFO overflow (i.e. for want of a free receive descriptor) */
+#define FEC_RING_MIBC           0x064
+#define FEC_RING_MIBC_DIS       BIT(31)
+#define FEC_RING_R_MACERR       0x2D8
+
+/* Time to wait for the controller to release transmit descriptors */
+#define FEC_RING_TX_TIMEOUT_US  5000
+
+/* Length of the CRC appended to each received frame */
+#define FEC_RING_CRC_LEN        4
+
+/* Interrupt events used to signal the client */
+#define FEC_RING_IRQ_EVENTS     (FEC_IEVENT_RXF | FEC_IEVENT_TXF)
+
+/* Interrupt coalescing registers, held in the reserved area of the register
+ * block described by the driver */
+#define FEC_RING_TXIC0          0x0F0
+#define FEC_RING_RXIC0          0x100
+
+#define FEC_RING_IC_EN          BIT(31)
+#define FEC_RING_IC_CS          BIT(30)
+#define FEC_RING_IC_FT(x)       (((x) & 0xff) << 20)
+#define FEC_RING_IC_TT(x)       ((x) & 0xffff)
+
+/* The coalescing timers are driven by the ENET system (AHB) clock, with the
+ * threshold counted in units of 64 cycles. The rate is read from the clock
+ * framework on attach; the default is the i.MX8MQ ENET_AXI_CLK_ROOT rate,
+ * used when the driver holds no clock. */
+#define FEC_RING_IC_CLK_DEFAULT 266000000ul
+#define FEC_RING_IC_CLK_DIV     64
+
+struct fec_ring_t {
+    /* The controller whose rings are managed */
+    struct fec_priv *fec;
+    bool attached;
+    /* Ring depths and buffer size, fixed for as long as buffers are held */
+    struct fec_ring_config config;
+    unsigned int rx_pool_size;
+    /* Transmit descriptors, and the buffer each copies its frame into */
+    struct fec_bd *tx_bd;
+    uint32_t tx_bd_paddr;
+    struct sel4_dma_pool tx_buf;
+    /* Next descriptor to fill, oldest descriptor owned by the controller and
+     * the number of descriptors owned by the controller */
+    unsigned int tx_head;
+    unsigned int tx_tail;
+    unsigned int tx_used;
+    /* Client cookie of the frame held by each transmit descriptor, and the
+     * time at which it was queued */
+    void **tx_cookie;
+    uint64_t *tx_stamp;
+    /* Frames queued and completed since the rings were allocated */
+    unsigned long tx_queued;
+    unsigned long tx_completed;
+    fec_ring_tx_complete_t tx_complete;
+    /* Pool of transmit buffers for the client */
+    struct sel4_dma_pool tx_pool;
+    /* Receive descriptors and the pool of receive buffers. Buffers free in
+     * the pool are those neither in the ring nor on loan. */
+    struct fec_bd *rx_bd;
+    uint32_t rx_bd_paddr;
+    struct sel4_dma_pool rx_pool;
+    /* Next descriptor to be checked for a received frame */
+    unsigned int rx_head;
+    /* Set while discarding the remaining descriptors of a frame too large
+     * for a single buffer */
+    bool rx_discard;
+    /* Pool buffer assigned to each receive descriptor */
+    uint16_t *rx_slot;
+    /* Pool buffers currently on loan to the client, and the time at which
+     * each was loaned */
+    bool *rx_loaned;
+    uint64_t *rx_stamp;
+    /* Interrupt mode and coalescing thresholds, reapplied on attach, and the
+     * rate of the clock driving the coalescing timers */
+    bool irq_enabled;
+    unsigned int rx_coalesce_frames;
+    unsigned int rx_coalesce_usecs;
+    unsigned int tx_coalesce_frames;
+    unsigned int tx_coalesce_usecs;
+    unsigned long ic_clk_rate;
+    /* Counters, and the controller's overflow count when last attached */
+    struct fec_ring_stats stats;
+    uint32_t rx_overflow_base;
+    /* Latency histograms, recorded while timestamping is enabled */
+    bool timestamps;
+    struct uboot_latency tx_latency;
+    struct uboot_latency rx_hold;
+};
+
+static struct fec_ring_t ring;
+
+static const struct fec_ring_config fec_ring_defaults = {
+    .rx_size = FEC_RING_RX_SIZE,
+    .rx_spare = FEC_RING_RX_SPARE,
+    .tx_size = FEC_RING_TX_SIZE,
+    .tx_pool = FEC_RING_TX_POOL,
+    .buf_size = FEC_RING_BUF_SIZE,
+};
+
+
+static void fec_ring_free(void)
+{
+    sel4_dma_pool_destroy(&ring.rx_pool);
+    sel4_dma_pool_destroy(&ring.tx_pool);
+    sel4_dma_pool_destroy(&ring.tx_buf);
+
+    if (ring.rx_bd != NULL)
+        sel4_dma_free(ring.rx_bd);
+    if (ring.tx_bd != NULL)
+        sel4_dma_free(ring.tx_bd);
+
+    free(ring.rx_stamp);
+    free(ring.rx_loaned);
+    free(ring.rx_slot);
+    free(ring.tx_stamp);
+    free(ring.tx_cookie);
+
+    ring.rx_bd = NULL;
+    ring.tx_bd = NULL;
+    ring.rx_stamp = NULL;
+    ring.rx_loaned = NULL;
+    ring.rx_slot = NULL;
+    ring.tx_stamp = NULL;
+    ring.tx_cookie = NULL;
+}
+
+static int fec_ring_alloc(void)
+{
+    struct fec_ring_config *config = &ring.config;
+    int ret = 0;
+
+    // Buffers are retained across detach / attach cycles, in particular so
+    // that buffers on loan to the client remain valid.
+    if (ring.tx_bd != NULL)
+        return 0;
+
+    if (config->tx_size == 0)
+        *config = fec_ring_defaults;
+    ring.rx_pool_size = config->rx_size + config->rx_spare;
+
+    ring.tx_bd = sel4_dma_memalign_uncached(CONFIG_SYS_CACHELINE_SIZE,
+        config->tx_size * sizeof(struct fec_bd));
+    ring.rx_bd = sel4_dma_memalign_uncached(CONFIG_SYS_CACHELINE_SIZE,
+        config->rx_size * sizeof(struct fec_bd));
+    if (ring.tx_bd == NULL || ring.rx_bd == NULL)
+        UBOOT_LOGE("Ethernet rings require an uncached DMA pool");
+
+    ring.tx_cookie = calloc(config->tx_size, sizeof(void *));
+    ring.tx_stamp = calloc(config->tx_size, sizeof(uint64_t));
+    ring.rx_slot = calloc(config->rx_size, sizeof(uint16_t));
+    ring.rx_loaned = calloc(ring.rx_pool_size, sizeof(bool));
+    ring.rx_stamp = calloc(ring.rx_pool_size, sizeof(uint64_t));
+
+    if (ring.tx_bd == NULL || ring.rx_bd == NULL || ring.tx_cookie == NULL ||
+        ring.tx_stamp == NULL || ring.rx_slot == NULL || ring.rx_loaned == NULL ||
+        ring.rx_stamp == NULL)
+        ret = -ENOMEM;
+    if (ret == 0)
+        ret = sel4_dma_pool_create(&ring.tx_buf, config->buf_size, config->tx_size);
+    if (ret == 0)
+        ret = sel4_dma_pool_create(&ring.tx_pool, config->buf_size, config->tx_pool);
+    if (ret == 0)
+        ret = sel4_dma_pool_create(&ring.rx_pool, config->buf_size, ring.rx_pool_size);
+
+    if (ret != 0) {
+        fec_ring_free();
+        return ret;
+    }
+
+    ring.tx_bd_paddr = (uint32_t)(uintptr_t) sel4_dma_virt_to_phys(ring.tx_bd);
+    ring.rx_bd_paddr = (uint32_t)(uintptr_t) sel4_dma_virt_to_phys(ring.rx_bd);
+
+    return 0;
+}
+
+static void fec_ring_tx_abort(void)
+{
+    // Frames still queued from a previous attach will never be sent; their
+    // buffers are no longer in use by the (disabled) controller.
+    while (ring.tx_used > 0) {
+        if (ring.tx_complete != NULL)
+            ring.tx_complete(ring.tx_cookie[ring.tx_tail]);
+        ring.tx_tail = (ring.tx_tail + 1) % ring.config.tx_size;
+        ring.tx_used--;
+        ring.tx_completed++;
+    }
+}
+
+static bool fec_ring_buffers_held(void)
+{
+    for (unsigned int i = 0; ring.rx_loaned != NULL && i < ring.rx_pool_size; i++)
+        if (ring.rx_loaned[i])
+            return true;
+
+    return ring.tx_pool.free_count != ring.tx_pool.count;
+}
+
+int fec_ring_configure(const struct fec_ring_config *config)
+{
+    struct fec_ring_config new_config = *config;
+
+    // Unspecified values take their defaults.
+    if (new_config.rx_size == 0)
+        new_config.rx_size = fec_ring_defaults.rx_size;
+    if (new_config.rx_spare == 0)
+        new_config.rx_spare = fec_ring_defaults.rx_spare;
+    if (new_config.tx_size == 0)
+        new_config.tx_size = fec_ring_defaults.tx_size;
+    if (new_config.tx_pool == 0)
+        new_config.tx_pool = fec_ring_defaults.tx_pool;
+    if (new_config.buf_size == 0)
+        new_config.buf_size = fec_ring_defaults.buf_size;
+
+    if (new_config.rx_size < FEC_RING_MIN_SIZE || new_config.tx_size < FEC_RING_MIN_SIZE ||
+        new_config.rx_size + new_config.rx_spare > FEC_RING_MAX_SIZE ||
+        new_config.tx_size > FEC_RING_MAX_SIZE) {
+        UBOOT_LOGE("Invalid ring sizes, must be from %u up to %u",
+            FEC_RING_MIN_SIZE, FEC_RING_MAX_SIZE);
+        return -EINVAL;
+    }
+
+    if (new_config.buf_size % CONFIG_SYS_CACHELINE_SIZE != 0 ||
+        new_config.buf_size < FEC_RING_MIN_BUF_SIZE ||
+        new_config.buf_size > FEC_RING_BUF_SIZE) {
+        UBOOT_LOGE("Invalid buffer size %u", new_config.buf_size);
+        return -EINVAL;
+    }
+
+    if (memcmp(&new_config, &ring.config, sizeof(new_config)) == 0)
+        return 0;
+
+    // The rings can only be resized while the client holds none of the
+    // buffers, which would otherwise be released from under it.
+    if (ring.attached || fec_ring_buffers_held()) {
+        UBOOT_LOGE("Unable to resize ethernet rings while in use");
+        return -EBUSY;
+    }
+
+    fec_ring_tx_abort();
+    fec_ring_free();
+    ring.config = new_config;
+
+    return 0;
+}
+
+static void fec_ring_init_tx(void)
+{
+    fec_ring_tx_abort();
+
+    for (unsigned int i = 0; i < ring.config.tx_size; i++) {
+        writew(0, &ring.tx_bd[i].data_length);
+        writel(sel4_dma_pool_paddr(&ring.tx_buf, sel4_dma_pool_object(&ring.tx_buf, i)),
+            &ring.tx_bd[i].data_pointer);
+        writew((i == ring.config.tx_size - 1) ? FEC_TBD_WRAP : 0, &ring.tx_bd[i].status);
+    }
+
+    ring.tx_head = 0;
+    ring.tx_tail = 0;
+    ring.tx_used = 0;
+}
+
+static inline uint8_t *fec_ring_rx_buf(unsigned int index)
+{
+    return sel4_dma_pool_object(&ring.rx_pool, index);
+}
+
+static void fec_ring_rx_arm(unsigned int index)
+{
+    // Hand a receive descriptor back to the controller. Any lines of the
+    // attached buffer dirtied by the client are discarded so they cannot
+    // later be evicted over received data.
+    uint8_t *buf = fec_ring_rx_buf(ring.rx_slot[index]);
+    invalidate_dcache_range((ulong) buf, (ulong) buf + ring.config.buf_size);
+
+    writel(sel4_dma_pool_paddr(&ring.rx_pool, buf), &ring.rx_bd[index].data_pointer);
+    writew(0, &ring.rx_bd[index].data_length);
+    writew(FEC_RBD_EMPTY | ((index == ring.config.rx_size - 1) ? FEC_RBD_WRAP : 0),
+        &ring.rx_bd[index].status);
+}
+
+static inline bool fec_ring_rx_idle(void)
+{
+    // The ring is drained once the next descriptor is still owned by the
+    // controller.
+    return readw(&ring.rx_bd[ring.rx_head].status) & FEC_RBD_EMPTY;
+}
+
+static void fec_ring_init_rx(void)
+{
+    struct sel4_dma_pool *pool = &ring.rx_pool;
+
+    // Every buffer not on loan to the client is available to the ring.
+    pool->free_count = 0;
+    for (int i = ring.rx_pool_size - 1; i >= 0; i--)
+        if (!ring.rx_loaned[i])
+            pool->free[pool->free_count++] = i;
+
+    // At most 'rx_spare' buffers can be on loan, so there is always a buffer
+    // for every descriptor.
+    for (unsigned int i = 0; i < ring.config.rx_size; i++)
+        ring.rx_slot[i] = sel4_dma_pool_index(pool, sel4_dma_pool_alloc(pool));
+
+    for (unsigned int i = 0; i < ring.config.rx_size; i++)
+        fec_ring_rx_arm(i);
+
+    ring.rx_head = 0;
+    ring.rx_discard = false;
+}
+
+static inline u32 *fec_ring_reg(struct fec_priv *fec, unsigned int offset)
+{
+    return (u32 *)((uintptr_t) fec->eth + offset);
+}
+
+static unsigned long fec_ring_ic_clk_rate(struct fec_priv *fec)
+{
+#if CONFIG_IS_ENABLED(CLK)
+    ulong rate = clk_get_rate(&fec->ahb_clk);
+
+    if (rate != 0 && !IS_ERR_VALUE(rate))
+        return rate;
+#endif
+    return FEC_RING_IC_CLK_DEFAULT;
+}
+
+static uint32_t fec_ring_coalesce_value(unsigned int frames, unsigned int usecs)
+{
+    // Coalescing is only meaningful with both thresholds set; either being
+    // zero disables it, raising an interrupt for every frame.
+    if (frames == 0 || usecs == 0)
+        return 0;
+
+    unsigned long long ticks = DIV_ROUND_UP((unsigned long long) usecs *
+        (ring.ic_clk_rate / 1000000), FEC_RING_IC_CLK_DIV);
+
+    return FEC_RING_IC_EN | FEC_RING_IC_CS |
+        FEC_RING_IC_FT(min(frames, 255u)) |
+        FEC_RING_IC_TT(min(ticks, 0xffffull));
+}
+
+static void fec_ring_apply_coalescing(struct fec_priv *fec)
+{
+    // The registers may only be changed with coalescing disabled.
+    writel(0, fec_ring_reg(fec, FEC_RING_TXIC0));
+    writel(0, fec_ring_reg(fec, FEC_RING_RXIC0));
+    writel(fec_ring_coalesce_value(ring.tx_coalesce_frames, ring.tx_coalesce_usecs),
+        fec_ring_reg(fec, FEC_RING_TXIC0));
+    writel(fec_ring_coalesce_value(ring.rx_coalesce_frames, ring.rx_coalesce_usecs),
+        fec_ring_reg(fec, FEC_RING_RXIC0));
+}
+
+static void fec_ring_apply_irq(struct fec_priv *fec)
+{
+    fec_ring_apply_coalescing(fec);
+
+    // Discard stale events before unmasking, so the first interrupt
+    // corresponds to a frame in the newly attached ring.
+    writel(FEC_RING_IRQ_EVENTS, &fec->eth->ievent);
+    writel(ring.irq_enabled ? FEC_RING_IRQ_EVENTS : 0, &fec->eth->imask);
+}
+
+int fec_ring_attach(struct udevice *dev)
+{
+    struct fec_priv *fec = dev_get_priv(dev);
+    int ret;
+
+    // Allocate before touching the controller so that on failure the driver
+    // retains ownership of a working device.
+    ret = fec_ring_alloc();
+    if (ret)
+        return ret;
+
+    // Disable the controller. This resets its internal descriptor pointers
+    // while leaving the remainder of its configuration (including the speed
+    // negotiated by the driver) intact.
+    u32 ecntrl = readl(&fec->eth->ecntrl);
+    writel(ecntrl & ~FEC_ECNTRL_ETHER_EN, &fec->eth->ecntrl);
+
+    fec_ring_init_tx();
+    fec_ring_init_rx();
+    writel(ring.tx_bd_paddr, &fec->eth->etdsr);
+    writel(ring.rx_bd_paddr, &fec->eth->erdsr);
+    writel(ring.config.buf_size, &fec->eth->emrbr);
+
+    // Ensure the statistics counters are running, and note the overflow
+    // count from which to measure.
+    u32 mibc = readl(fec_ring_reg(fec, FEC_RING_MIBC));
+    writel(mibc & ~FEC_RING_MIBC_DIS, fec_ring_reg(fec, FEC_RING_MIBC));
+    ring.rx_overflow_base = readl(fec_ring_reg(fec, FEC_RING_R_MACERR));
+
+    ring.ic_clk_rate = fec_ring_ic_clk_rate(fec);
+
+    // Re-enable the controller and restart reception.
+    writel(ecntrl, &fec->eth->ecntrl);
+    fec_ring_apply_irq(fec);
+    writel(FEC_R_DES_ACTIVE_RDAR, &fec->eth->r_des_active);
+
+    ring.fec = fec;
+    ring.attached = true;
+
+    return 0;
+}
+
+void fec_ring_detach(void)
+{
+    // The driver itself only ever polls, so leave the interrupt masked.
+    if (ring.attached) {
+        writel(0, &ring.fec->eth->imask);
+        ring.stats.rx_overflow += readl(fec_ring_reg(ring.fec, FEC_RING_R_MACERR)) -
+            ring.rx_overflow_base;
+    }
+
+    ring.attached = false;
+    ring.fec = NULL;
+}
+
+void fec_ring_resync(struct udevice *dev)
+{
+    if (!ring.attached)
+        return;
+
+    // A restart of the device by the driver points the controller back at
+    // the driver's own transmit ring.
+    if (readl(&ring.fec->eth->etdsr) == ring.tx_bd_paddr)
+        return;
+
+    fec_ring_detach();
+
+    if (dev != NULL && eth_is_active(dev))
+        if (fec_ring_attach(dev) != 0)
+            UBOOT_LOGE("Failed to re-attach ethernet rings");
+}
+
+void fec_ring_shutdown(void)
+{
+    fec_ring_detach();
+    fec_ring_tx_abort();
+    fec_ring_free();
+}
+
+bool fec_ring_attached(void)
+{
+    return ring.attached;
+}
+
+int fec_ring_tx_reclaim(void)
+{
+    int reclaimed = 0;
+    uint64_t now = 0;
+
+    while (ring.tx_used > 0) {
+        struct fec_bd *bd = &ring.tx_bd[ring.tx_tail];
+
+        if (readw(&bd->status) & FEC_TBD_READY)
+            break;
+
+        // A single timestamp serves the whole batch of completions.
+        if (ring.timestamps && ring.tx_stamp[ring.tx_tail] != 0) {
+            if (now == 0)
+                now = get_ticks();
+            uboot_latency_record(&ring.tx_latency, now - ring.tx_stamp[ring.tx_tail]);
+        }
+
+        if (ring.tx_complete != NULL)
+            ring.tx_complete(ring.tx_cookie[ring.tx_tail]);
+
+        ring.tx_tail = (ring.tx_tail + 1) % ring.config.tx_size;
+        ring.tx_used--;
+        ring.tx_completed++;
+        reclaimed++;
+    }
+
+    return reclaimed;
+}
+
+static int fec_ring_queue(unsigned char **packets, int *lengths, void **cookies,
+    int count)
+{
+    int queued = 0;
+    uint64_t stamp = 0;
+
+    if (!ring.attached)
+        return -ENODEV;
+
+    if (ring.timestamps)
+        stamp = get_ticks();
+
+    for (int i = 0; i < count; i++)
+        if (lengths[i] <= 0 || (unsigned int) lengths[i] > ring.config.buf_size) {
+            UBOOT_LOGE("Invalid packet length %i", lengths[i]);
+            return -EINVAL;
+        }
+
+    // Lazily reclaim anything the controller has finished with.
+    fec_ring_tx_reclaim();
+
+    // Every descriptor not owned by the controller may be filled, regardless
+    // of its neighbours.
+    while (queued < count && ring.tx_used < ring.config.tx_size) {
+        int length = lengths[queued];
+        unsigned char *packet = packets[queued];
+        struct fec_bd *bd = &ring.tx_bd[ring.tx_head];
+        uint32_t paddr;
+
+        if (fec_ring_is_tx_buffer(packet)) {
+            // Transmit directly from the client's pool buffer.
+            paddr = sel4_dma_pool_paddr(&ring.tx_pool, packet);
+            flush_dcache_range((ulong) packet,
+                (ulong) packet + roundup(length, ARCH_DMA_MINALIGN));
+        } else {
+            uint8_t *buf = sel4_dma_pool_object(&ring.tx_buf, ring.tx_head);
+            memcpy(buf, packet, length);
+            flush_dcache_range((ulong) buf, (ulong) buf + roundup(length, ARCH_DMA_MINALIGN));
+            paddr = sel4_dma_pool_paddr(&ring.tx_buf, buf);
+        }
+
+        ring.tx_cookie[ring.tx_head] = (cookies != NULL) ? cookies[queued] : NULL;
+        ring.tx_stamp[ring.tx_head] = stamp;
+        ring.stats.tx_bytes += length;
+
+        // The status is written last, handing the descriptor over.
+        u16 status = readw(&bd->status) & FEC_TBD_WRAP;
+        status |= FEC_TBD_LAST | FEC_TBD_TC | FEC_TBD_READY;
+        writel(paddr, &bd->data_pointer);
+        writew(length, &bd->data_length);
+        writew(status, &bd->status);
+
+        ring.tx_head = (ring.tx_head + 1) % ring.config.tx_size;
+        ring.tx_used++;
+        ring.tx_queued++;
+        queued++;
+    }
+
+    // Ring the transmit doorbell once for the whole burst.
+    if (queued > 0) {
+        wmb();
+        writel(FEC_X_DES_ACTIVE_TDAR, &ring.fec->eth->x_des_active);
+    }
+
+    return queued;
+}
+
+int fec_ring_send_burst(unsigned char **packets, int *lengths, int count)
+{
+    int ret = fec_ring_queue(packets, lengths, NULL, count);
+
+    if (ret >= 0 && ret < count)
+        ring.stats.tx_ring_full++;
+
+    return ret;
+}
+
+int fec_ring_send_async(unsigned char *packet, int length, void *cookie)
+{
+    int ret = fec_ring_queue(&packet, &length, &cookie, 1);
+
+    if (ret < 0)
+        return ret;
+
+    if (ret == 0) {
+        ring.stats.tx_ring_full++;
+        return -EAGAIN;
+    }
+
+    return 0;
+}
+
+int fec_ring_send(unsigned char *packet, int length)
+{
+    ulong start = timer_get_us();
+    bool waited = false;
+
+    for (;;) {
+        int ret = fec_ring_queue(&packet, &length, NULL, 1);
+        if (ret != 0)
+            return (ret > 0) ? 0 : ret;
+
+        // Ring full; wait for the controller to release a descriptor. The
+        // send is counted once however long it waits.
+        if (!waited) {
+            ring.stats.tx_ring_full++;
+            waited = true;
+        }
+
+        if (timer_get_us() - start > FEC_RING_TX_TIMEOUT_US) {
+            UBOOT_LOGE("Timeout waiting for a free transmit descriptor");
+            return -ETIMEDOUT;
+        }
+    }
+}
+
+int fec_ring_receive_burst(unsigned char **packets, int *lengths, int max)
+{
+    int count = 0;
+    int armed = 0;
+    uint64_t stamp = 0;
+
+    if (!ring.attached)
+        return -ENODEV;
+
+    while (count < max) {
+        struct fec_bd *bd = &ring.rx_bd[ring.rx_head];
+
+        u16 status = readw(&bd->status);
+        if (status & FEC_RBD_EMPTY)
+            break;
+
+        // Leave the frame in the ring if every spare buffer is on loan; it
+        // will be delivered once the client returns a buffer.
+        if (ring.rx_pool.free_count == 0) {
+            ring.stats.rx_pool_empty++;
+            break;
+        }
+
+        int length = readw(&bd->data_length) - FEC_RING_CRC_LEN;
+
+        if (!(status & FEC_RBD_LAST)) {
+            // The frame is larger than a buffer and continues in the next
+            // descriptor. The whole frame is dropped.
+            ring.rx_discard = true;
+        } else if (ring.rx_discard || (status & FEC_RBD_ERR) ||
+                   length <= ETHER_HDR_SIZE) {
+            // Errored frames are dropped, the descriptor keeps its buffer.
+            UBOOT_LOGD("Dropping received frame, status 0x%x", status);
+            ring.rx_discard = false;
+            ring.stats.rx_errors++;
+        } else {
+            // Loan the buffer to the client and give the descriptor a spare.
+            unsigned int index = ring.rx_slot[ring.rx_head];
+            uint8_t *buf = fec_ring_rx_buf(index);
+
+            invalidate_dcache_range((ulong) buf,
+                (ulong) buf + roundup(length, ARCH_DMA_MINALIGN));
+
+            if (ring.timestamps && stamp == 0)
+                stamp = get_ticks();
+
+            ring.rx_loaned[index] = true;
+            ring.rx_stamp[index] = stamp;
+            ring.rx_slot[ring.rx_head] = sel4_dma_pool_index(&ring.rx_pool,
+                sel4_dma_pool_alloc(&ring.rx_pool));
+            ring.stats.rx_frames++;
+            ring.stats.rx_bytes += length;
+
+            packets[count] = buf;
+            lengths[count] = length;
+            count++;
+        }
+
+        // Return the descriptor to the controller straight away.
+        fec_ring_rx_arm(ring.rx_head);
+        armed++;
+
+        ring.rx_head = (ring.rx_head + 1) % ring.config.rx_size;
+    }
+
+    // Restart reception once for the whole burst, in case the controller
+    // had run out of descriptors.
+    if (armed > 0) {
+        wmb();
+        writel(FEC_R_DES_ACTIVE_RDAR, &ring.fec->eth->r_des_active);
+    }
+
+    return count;
+}
+
+bool fec_ring_is_packet(unsigned char *packet)
+{
+    return sel4_dma_pool_contains(&ring.rx_pool, packet);
+}
+
+int fec_ring_free_packet(unsigned char *packet)
+{
+    if (!fec_ring_is_packet(packet)) {
+        UBOOT_LOGE("Packet %p is not a receive buffer", packet);
+        return -EINVAL;
+    }
+
+    unsigned int index = sel4_dma_pool_index(&ring.rx_pool, packet);
+    if (!ring.rx_loaned[index]) {
+        UBOOT_LOGE("Packet %p is not on loan", packet);
+        return -EINVAL;
+    }
+
+    // Return the buffer to the pool. It is attached to a descriptor as one
+    // is next loaned out.
+    if (ring.timestamps && ring.rx_stamp[index] != 0)
+        uboot_latency_record(&ring.rx_hold, get_ticks() - ring.rx_stamp[index]);
+
+    ring.rx_loaned[index] = false;
+    sel4_dma_pool_free(&ring.rx_pool, fec_ring_rx_buf(index));
+
+    return 0;
+}
+
+int fec_ring_irq_enable(bool enable)
+{
+    ring.irq_enabled = enable;
+
+    if (ring.attached)
+        fec_ring_apply_irq(ring.fec);
+
+    return 0;
+}
+
+int fec_ring_irq_poll(unsigned char **packets, int *lengths, int budget)
+{
+    if (!ring.attached)
+        return -ENODEV;
+
+    // Mask the interrupt while draining, and acknowledge it before checking
+    // the ring so that a frame arriving after the final check raises a
+    // fresh event rather than being missed.
+    writel(0, &ring.fec->eth->imask);
+    writel(FEC_RING_IRQ_EVENTS, &ring.fec->eth->ievent);
+
+    // Reap transmit completions, notifying the client.
+    fec_ring_tx_reclaim();
+
+    int count = fec_ring_receive_burst(packets, lengths, budget);
+
+    // Only re-enable the interrupt once the ring has been drained. A burst
+    // may stop with frames still waiting, either on the budget or because
+    // every spare buffer is on loan; those frames raise no further event, so
+    // the interrupt stays masked and the client must poll again. A frame
+    // arriving after a burst that simply found the ring empty has raised a
+    // fresh event, which fires as soon as the interrupt is unmasked.
+    bool stalled = count == budget || ring.rx_pool.free_count == 0;
+    if (count >= 0 && ring.irq_enabled && (!stalled || fec_ring_rx_idle()))
+        writel(FEC_RING_IRQ_EVENTS, &ring.fec->eth->imask);
+
+    return count;
+}
+
+int fec_ring_set_coalescing(unsigned int rx_frames, unsigned int rx_usecs,
+    unsigned int tx_frames, unsigned int tx_usecs)
+{
+    ring.rx_coalesce_frames = rx_frames;
+    ring.rx_coalesce_usecs = rx_usecs;
+    ring.tx_coalesce_frames = tx_frames;
+    ring.tx_coalesce_usecs = tx_usecs;
+
+    if (ring.attached)
+        fec_ring_apply_coalescing(ring.fec);
+
+    return 0;
+}
+
+bool fec_ring_is_tx_buffer(unsigned char *buffer)
+{
+    return sel4_dma_pool_contains(&ring.tx_pool, buffer);
+}
+
+unsigned char *fec_ring_alloc_tx_buffer(void)
+{
+    // The pool is allocated along with the rings.
+    if (fec_ring_alloc() != 0)
+        return NULL;
+
+    return sel4_dma_pool_alloc(&ring.tx_pool);
+}
+
+/* Whether a frame sent from the buffer is still owned by the controller.
+ * Descriptors are examined rather than reclaimed, as this may be called from
+ * a completion. */
+static bool fec_ring_tx_queued(unsigned char *buffer)
+{
+    uint32_t paddr = sel4_dma_pool_paddr(&ring.tx_pool, buffer);
+
+    // A detached controller is disabled, and its queue aborted on attach.
+    if (!ring.attached)
+        return false;
+
+    for (unsigned int i = 0; i < ring.tx_used; i++) {
+        struct fec_bd *bd = &ring.tx_bd[(ring.tx_tail + i) % ring.config.tx_size];
+        if (readl(&bd->data_pointer) == paddr && (readw(&bd->status) & FEC_TBD_READY))
+            return true;
+    }
+
+    return false;
+}
+
+int fec_ring_free_tx_buffer(unsigned char *buffer)
+{
+    if (!fec_ring_is_tx_buffer(buffer)) {
+        UBOOT_LOGE("Buffer %p is not a transmit buffer", buffer);
+        return -EINVAL;
+    }
+
+    if (fec_ring_tx_queued(buffer)) {
+        UBOOT_LOGE("Transmit buffer %p is still queued", buffer);
+        return -EBUSY;
+    }
+
+    return sel4_dma_pool_free(&ring.tx_pool, buffer);
+}
+
+void fec_ring_set_tx_complete(fec_ring_tx_complete_t callback)
+{
+    ring.tx_complete = callback;
+}
+
+unsigned long fec_ring_tx_completed(void)
+{
+    return ring.tx_completed;
+}
+
+void fec_ring_get_stats(struct fec_ring_stats *stats)
+{
+    *stats = ring.stats;
+    stats->tx_frames = ring.tx_queued;
+    stats->tx_in_flight = ring.tx_used;
+    stats->rx_held = (ring.rx_pool_size > 0) ?
+        ring.rx_pool_size - ring.config.rx_size - ring.rx_pool.free_count : 0;
+
+    if (ring.attached)
+        stats->rx_overflow += readl(fec_ring_reg(ring.fec, FEC_RING_R_MACERR)) -
+            ring.rx_overflow_base;
+}
+
+void fec_ring_enable_timestamps(bool enable)
+{
+    // Samples taken before timestamps were last disabled are stale, so
+    // each frame in flight is marked as unstamped.
+    for (unsigned int i = 0; ring.tx_stamp != NULL && i < ring.config.tx_size; i++)
+        ring.tx_stamp[i] = 0;
+    for (unsigned int i = 0; ring.rx_stamp != NULL && i < ring.rx_pool_size; i++)
+        ring.rx_stamp[i] = 0;
+
+    ring.timestamps = enable;
+}
+
+void fec_ring_get_latency(struct uboot_latency *tx_latency, struct uboot_latency *rx_hold)
+{
+    *tx_latency = ring.tx_latency;
+    *rx_hold = ring.rx_hold;
+}
+
+void fec_ring_reset_stats(void)
+{
+    memset(&ring.stats, 0, sizeof(ring.stats));
+    memset(&ring.tx_latency, 0, sizeof(ring.tx_latency));
+    memset(&ring.rx_hold, 0, sizeof(ring.rx_hold));
+    ring.tx_queued = 0;
+
+    if (ring.attached)
+        ring.rx_overflow_base = readl(fec_ring_reg(ring.fec, FEC_RING_R_MACERR));
+}
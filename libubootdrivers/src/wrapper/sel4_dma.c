@@ -251,7 +251,7 @@ void sel4_dma_free(void *vaddr)
     clear_allocation(alloc_index);
 }
 
-void* sel4_dma_memalign(size_t align, size_t size)
+static void* sel4_dma_alloc(size_t align, size_t size, bool cached)
 {
     assert(sel4_dma_manager != NULL);
 
@@ -264,7 +264,7 @@ void* sel4_dma_memalign(size_t align, size_t size)
     void* mapped_vaddr = sel4_dma_manager->dma_alloc_fn(
         size,
         align,
-        true,
+        cached,
         PS_MEM_NORMAL);
    
     if (mapped_vaddr == NULL) {
@@ -300,6 +300,16 @@ void* sel4_dma_memalign(size_t align, size_t size)
     return mapped_vaddr;
 }
 
+void* sel4_dma_memalign(size_t align, size_t size)
+{
+    return sel4_dma_alloc(align, size, true);
+}
+
+void* sel4_dma_memalign_uncached(size_t align, size_t size)
+{
+    return sel4_dma_alloc(align, size, false);
+}
+
 void* sel4_dma_malloc(size_t size)
 {
     /* Default to alignment on cacheline boundaries */
@@ -379,6 +389,108 @@ void sel4_dma_unmap_single(void* paddr)
     sel4_dma_free(public_vaddr);
 }
 
+/* Routines to manage pools of fixed size DMA objects */
+
+#define SEL4_DMA_POOL_WORD_BITS (8 * sizeof(unsigned long))
+
+static inline bool sel4_dma_pool_test(struct sel4_dma_pool *pool, unsigned int index)
+{
+    return pool->allocated[index / SEL4_DMA_POOL_WORD_BITS] &
+        (1UL << (index % SEL4_DMA_POOL_WORD_BITS));
+}
+
+static inline void sel4_dma_pool_set(struct sel4_dma_pool *pool, unsigned int index,
+    bool allocated)
+{
+    unsigned long mask = 1UL << (index % SEL4_DMA_POOL_WORD_BITS);
+
+    if (allocated)
+        pool->allocated[index / SEL4_DMA_POOL_WORD_BITS] |= mask;
+    else
+        pool->allocated[index / SEL4_DMA_POOL_WORD_BITS] &= ~mask;
+}
+
+int sel4_dma_pool_create(struct sel4_dma_pool *pool, size_t object_size, unsigned int count)
+{
+    memset(pool, 0, sizeof(*pool));
+
+    if (object_size == 0 || count == 0)
+        return -EINVAL;
+
+    /* Objects are individually flushed and invalidated, so must not share
+     * a cache line with their neighbours */
+    object_size = roundup(object_size, CONFIG_SYS_CACHELINE_SIZE);
+
+    pool->free = malloc(count * sizeof(unsigned int));
+    pool->allocated = calloc(DIV_ROUND_UP(count, SEL4_DMA_POOL_WORD_BITS),
+        sizeof(unsigned long));
+    pool->base = sel4_dma_memalign(CONFIG_SYS_CACHELINE_SIZE, object_size * count);
+    if (pool->free == NULL || pool->allocated == NULL || pool->base == NULL) {
+        sel4_dma_pool_destroy(pool);
+        return -ENOMEM;
+    }
+
+    pool->paddr = (uintptr_t) sel4_dma_virt_to_phys(pool->base);
+    pool->object_size = object_size;
+    pool->count = count;
+
+    /* Hand out objects in ascending address order */
+    for (int x = count - 1; x >= 0; x--)
+        pool->free[pool->free_count++] = x;
+
+    return 0;
+}
+
+void sel4_dma_pool_destroy(struct sel4_dma_pool *pool)
+{
+    if (pool->base != NULL)
+        sel4_dma_free(pool->base);
+    if (pool->free != NULL)
+        free(pool->free);
+    if (pool->allocated != NULL)
+        free(pool->allocated);
+
+    memset(pool, 0, sizeof(*pool));
+}
+
+void* sel4_dma_pool_alloc(struct sel4_dma_pool *pool)
+{
+    if (pool->free_count == 0)
+        return NULL;
+
+    unsigned int index = pool->free[--pool->free_count];
+    sel4_dma_pool_set(pool, index, true);
+
+    return sel4_dma_pool_object(pool, index);
+}
+
+int sel4_dma_pool_free(struct sel4_dma_pool *pool, void *object)
+{
+    if (!sel4_dma_pool_contains(pool, object) ||
+        ((uint8_t *) object - pool->base) % pool->object_size != 0) {
+        UBOOT_LOGE("Call to free %p not allocated from DMA pool", object);
+        return -EINVAL;
+    }
+
+    unsigned int index = sel4_dma_pool_index(pool, object);
+    if (!sel4_dma_pool_test(pool, index)) {
+        UBOOT_LOGE("Call to free %p already free in DMA pool", object);
+        return -EINVAL;
+    }
+
+    sel4_dma_pool_set(pool, index, false);
+    pool->free[pool->free_count++] = index;
+
+    return 0;
+}
+
+bool sel4_dma_pool_contains(struct sel4_dma_pool *pool, void *vaddr)
+{
+    return pool->base != NULL &&
+        (uint8_t *) vaddr >= pool->base &&
+        (uint8_t *) vaddr < pool->base + pool->count * pool->object_size;
+}
+
 /* Map data cache requests on to DMA requests. Note that U-Boot code that is
  * requesting the data cache to be flushed or invalidated is expecting those
  * addresses to be DMA mapped. */
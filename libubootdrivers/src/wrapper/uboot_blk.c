@@ -0,0 +1,338 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This file provides direct access to block devices (e.g. SD cards and USB
+ * mass storage) through the blk uclass, without the formatting, parsing
+ * and logging of a U-Boot command for each transfer.
+ *
+ * Requests may also be queued, to be performed when the queue is polled.
+ * Queued requests for consecutive blocks of a device are merged into a
+ * single transfer, gathered from or scattered to the separate buffers of
+ * the requests, and each request is completed through a callback.
+ */
+
+#include <uboot_helper.h>
+#include <blk.h>
+#include <mmc.h>
+#include <asm/global_data.h>
+#include <sel4_dma.h>
+#include <uboot_blkcache.h>
+#include "../../include/public_api/uboot_drivers.h"
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Maximum number of block devices open at once */
+#define UBOOT_BLK_MAX_HANDLES   4
+
+/* Maximum number of queued requests, and the largest transfer (bytes) into
+ * which requests are merged */
+#define UBOOT_BLK_QUEUE_LEN     32
+#define UBOOT_BLK_MERGE_SIZE    (256 * 1024)
+
+struct uboot_blk_handle {
+    struct blk_desc *desc;
+    unsigned int users;
+};
+
+struct uboot_blk_request_t {
+    struct uboot_blk_handle *handle;
+    bool write;
+    unsigned long lba;
+    unsigned long count;
+    void *buffer;
+    uboot_blk_complete_t complete;
+    void *cookie;
+};
+
+static struct uboot_blk_handle handles[UBOOT_BLK_MAX_HANDLES];
+
+/* Queue of submitted requests, performed in order of submission */
+static struct uboot_blk_request_t queue[UBOOT_BLK_QUEUE_LEN];
+static unsigned int queue_head;
+static unsigned int queue_count;
+
+/* Buffer through which merged requests are gathered and scattered */
+static uint8_t *merge_buffer;
+
+
+static bool uboot_blk_valid(struct uboot_blk_handle *handle)
+{
+    return handle >= &handles[0] && handle < &handles[UBOOT_BLK_MAX_HANDLES] &&
+        handle->users > 0;
+}
+
+static int uboot_blk_prepare(const char *iface, int devnum)
+{
+#ifdef CONFIG_DM_MMC
+    // As with the 'mmc' command, the card is initialised on first use
+    // rather than when the library is initialised.
+    if (strcmp(iface, "mmc") == 0) {
+        struct mmc *mmc = find_mmc_device(devnum);
+        if (mmc == NULL)
+            return -ENODEV;
+        return mmc_init(mmc);
+    }
+#endif
+
+    return 0;
+}
+
+struct uboot_blk_handle *uboot_blk_open(const char *iface, int devnum)
+{
+    struct uboot_blk_handle *handle = NULL;
+
+    // Return immediately if library not initialised.
+    if (gd == NULL || gd->dm_root == NULL || iface == NULL)
+        return NULL;
+
+    if (uboot_blk_prepare(iface, devnum) != 0) {
+        UBOOT_LOGE("Unable to initialise %s device %i", iface, devnum);
+        return NULL;
+    }
+
+    struct blk_desc *desc = blk_get_devnum_by_typename(iface, devnum);
+    if (desc == NULL || desc->type == DEV_TYPE_UNKNOWN || desc->blksz == 0) {
+        UBOOT_LOGE("No block device %s %i", iface, devnum);
+        return NULL;
+    }
+
+    // A device opened more than once shares a single handle.
+    for (int i = 0; i < UBOOT_BLK_MAX_HANDLES; i++) {
+        if (handles[i].users > 0 && handles[i].desc == desc) {
+            handles[i].users++;
+            return &handles[i];
+        }
+        if (handles[i].users == 0 && handle == NULL)
+            handle = &handles[i];
+    }
+
+    if (handle == NULL) {
+        UBOOT_LOGE("Too many open block devices");
+        return NULL;
+    }
+
+    handle->desc = desc;
+    handle->users = 1;
+
+    return handle;
+}
+
+void uboot_blk_close(struct uboot_blk_handle *handle)
+{
+    if (!uboot_blk_valid(handle))
+        return;
+
+    // Requests queued for the device are completed before it is closed.
+    while (queue_count > 0)
+        uboot_blk_poll(UBOOT_BLK_QUEUE_LEN);
+
+    if (--handle->users == 0) {
+        uboot_blkcache_flush(handle->desc->bdev);
+        handle->desc = NULL;
+    }
+}
+
+int uboot_blk_flush(struct uboot_blk_handle *handle)
+{
+    if (handle == NULL)
+        return uboot_blkcache_flush(NULL);
+
+    if (!uboot_blk_valid(handle))
+        return -EINVAL;
+
+    return uboot_blkcache_flush(handle->desc->bdev);
+}
+
+int uboot_blk_get_info(struct uboot_blk_handle *handle, struct uboot_blk_info *info)
+{
+    if (!uboot_blk_valid(handle) || info == NULL)
+        return -EINVAL;
+
+    info->block_size = handle->desc->blksz;
+    info->block_count = handle->desc->lba;
+
+    return 0;
+}
+
+static int uboot_blk_check_range(struct uboot_blk_handle *handle, unsigned long lba,
+    unsigned long count, const void *buffer)
+{
+    if (!uboot_blk_valid(handle) || buffer == NULL)
+        return -EINVAL;
+
+    if (lba > handle->desc->lba || count > handle->desc->lba - lba)
+        return -ERANGE;
+
+    return 0;
+}
+
+long uboot_blk_read(struct uboot_blk_handle *handle, unsigned long lba,
+    unsigned long count, void *buffer)
+{
+    int ret = uboot_blk_check_range(handle, lba, count, buffer);
+    if (ret < 0)
+        return ret;
+
+    if (count == 0)
+        return 0;
+
+    ulong blocks = blk_dread(handle->desc, lba, count, buffer);
+
+    return (blocks == count) ? (long) blocks : -EIO;
+}
+
+long uboot_blk_write(struct uboot_blk_handle *handle, unsigned long lba,
+    unsigned long count, const void *buffer)
+{
+    int ret = uboot_blk_check_range(handle, lba, count, buffer);
+    if (ret < 0)
+        return ret;
+
+    if (count == 0)
+        return 0;
+
+    ulong blocks = blk_dwrite(handle->desc, lba, count, buffer);
+
+    return (blocks == count) ? (long) blocks : -EIO;
+}
+
+int uboot_blk_submit(struct uboot_blk_handle *handle, int write, unsigned long lba,
+    unsigned long count, void *buffer, uboot_blk_complete_t complete, void *cookie)
+{
+    int ret = uboot_blk_check_range(handle, lba, count, buffer);
+    if (ret < 0)
+        return ret;
+
+    if (queue_count == UBOOT_BLK_QUEUE_LEN)
+        return -EAGAIN;
+
+    struct uboot_blk_request_t *request =
+        &queue[(queue_head + queue_count) % UBOOT_BLK_QUEUE_LEN];
+    request->handle = handle;
+    request->write = write;
+    request->lba = lba;
+    request->count = count;
+    request->buffer = buffer;
+    request->complete = complete;
+    request->cookie = cookie;
+    queue_count++;
+
+    return 0;
+}
+
+/* Count the requests from the head of the queue which can be merged into a
+ * single transfer, and whether their buffers are already contiguous */
+static unsigned int uboot_blk_merge_count(bool *contiguous)
+{
+    struct uboot_blk_request_t *first = &queue[queue_head];
+    unsigned long blksz = first->handle->desc->blksz;
+    unsigned long limit = merge_buffer ? UBOOT_BLK_MERGE_SIZE / blksz : 0;
+    unsigned long blocks = first->count;
+    unsigned int merged = 1;
+
+    *contiguous = true;
+
+    while (merged < queue_count) {
+        struct uboot_blk_request_t *prev = &queue[(queue_head + merged - 1) % UBOOT_BLK_QUEUE_LEN];
+        struct uboot_blk_request_t *next = &queue[(queue_head + merged) % UBOOT_BLK_QUEUE_LEN];
+
+        if (next->handle != first->handle || next->write != first->write ||
+            next->lba != prev->lba + prev->count)
+            break;
+
+        bool adjacent = (uint8_t *) next->buffer == (uint8_t *) prev->buffer + prev->count * blksz;
+
+        // Requests with separate buffers are merged through the merge
+        // buffer, and so only up to its size.
+        if ((!*contiguous || !adjacent) && blocks + next->count > limit)
+            break;
+
+        *contiguous = *contiguous && adjacent;
+        blocks += next->count;
+        merged++;
+    }
+
+    return merged;
+}
+
+static long uboot_blk_transfer(unsigned int merged, bool contiguous)
+{
+    struct uboot_blk_request_t *first = &queue[queue_head];
+    struct blk_desc *desc = first->handle->desc;
+    unsigned long blocks = 0;
+    uint8_t *buffer = first->buffer;
+
+    for (unsigned int i = 0; i < merged; i++)
+        blocks += queue[(queue_head + i) % UBOOT_BLK_QUEUE_LEN].count;
+
+    if (blocks == 0)
+        return 0;
+
+    if (!contiguous) {
+        buffer = merge_buffer;
+        if (first->write) {
+            uint8_t *p = buffer;
+            for (unsigned int i = 0; i < merged; i++) {
+                struct uboot_blk_request_t *request = &queue[(queue_head + i) % UBOOT_BLK_QUEUE_LEN];
+                memcpy(p, request->buffer, request->count * desc->blksz);
+                p += request->count * desc->blksz;
+            }
+        }
+    }
+
+    ulong done = first->write ? blk_dwrite(desc, first->lba, blocks, buffer) :
+        blk_dread(desc, first->lba, blocks, buffer);
+    if (done != blocks)
+        return -EIO;
+
+    if (!contiguous && !first->write) {
+        uint8_t *p = buffer;
+        for (unsigned int i = 0; i < merged; i++) {
+            struct uboot_blk_request_t *request = &queue[(queue_head + i) % UBOOT_BLK_QUEUE_LEN];
+            memcpy(request->buffer, p, request->count * desc->blksz);
+            p += request->count * desc->blksz;
+        }
+    }
+
+    return 0;
+}
+
+int uboot_blk_poll(int budget)
+{
+    int completed = 0;
+
+    if (merge_buffer == NULL && queue_count > 1)
+        merge_buffer = sel4_dma_memalign(ARCH_DMA_MINALIGN, UBOOT_BLK_MERGE_SIZE);
+
+    while (queue_count > 0 && budget-- > 0) {
+        struct uboot_blk_request_t done[UBOOT_BLK_QUEUE_LEN];
+        bool contiguous;
+        unsigned int merged = uboot_blk_merge_count(&contiguous);
+        long ret = uboot_blk_transfer(merged, contiguous);
+
+        // Remove the requests transferred from the queue before completing
+        // any, so that a callback may submit another, or close a handle
+        // (polling the queue again) without disturbing those yet to
+        // complete.
+        for (unsigned int i = 0; i < merged; i++) {
+            done[i] = queue[queue_head];
+            queue_head = (queue_head + 1) % UBOOT_BLK_QUEUE_LEN;
+            queue_count--;
+        }
+
+        for (unsigned int i = 0; i < merged; i++) {
+            if (done[i].complete != NULL)
+                done[i].complete(done[i].cookie, (ret < 0) ? ret : (long) done[i].count);
+            completed++;
+        }
+    }
+
+    return completed;
+}
+
+int uboot_blk_pending(void)
+{
+    return queue_count;
+}
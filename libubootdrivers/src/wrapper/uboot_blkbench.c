@@ -0,0 +1,259 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This file measures the throughput and latency of the block layer, reading
+ * or writing either raw blocks of a device or a file within a filesystem,
+ * sequentially or at random offsets. Every transfer passes through the same
+ * routines as any other user (the block cache included), so that results
+ * reflect changes to any part of the path to the device.
+ */
+
+#include <uboot_helper.h>
+#include <fs.h>
+#include <time.h>
+#include <asm/global_data.h>
+#include <uboot_latency.h>
+#include <uboot_fs.h>
+#include "../../include/public_api/uboot_drivers.h"
+
+DECLARE_GLOBAL_DATA_PTR;
+
+struct uboot_blkbench_state_t {
+    const struct uboot_blk_bench_config *config;
+    struct uboot_latency latency;
+    uint32_t random;
+    void *buffer;
+    /* operations possible within the region or file before wrapping */
+    unsigned long slots;
+};
+
+
+static uint32_t uboot_blkbench_random(struct uboot_blkbench_state_t *state)
+{
+    // xorshift32, which must not be seeded with zero.
+    uint32_t x = state->random;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    state->random = x;
+
+    return x;
+}
+
+/* Select the slot of the next operation, in order or at random */
+static unsigned long uboot_blkbench_slot(struct uboot_blkbench_state_t *state, unsigned long op)
+{
+    int workload = state->config->workload;
+
+    if (workload == UBOOT_BLK_BENCH_RAND_READ || workload == UBOOT_BLK_BENCH_RAND_WRITE)
+        return uboot_blkbench_random(state) % state->slots;
+
+    return op % state->slots;
+}
+
+static bool uboot_blkbench_is_write(int workload)
+{
+    return workload == UBOOT_BLK_BENCH_SEQ_WRITE || workload == UBOOT_BLK_BENCH_RAND_WRITE;
+}
+
+static int uboot_blkbench_raw(struct uboot_blkbench_state_t *state, unsigned long ops)
+{
+    const struct uboot_blk_bench_config *config = state->config;
+    struct uboot_blk_info info;
+    int ret = 0;
+
+    struct uboot_blk_handle *handle = uboot_blk_open(config->iface, config->devnum);
+    if (handle == NULL)
+        return -ENODEV;
+
+    uboot_blk_get_info(handle, &info);
+
+    unsigned long count = config->io_size / info.block_size;
+    unsigned long region = config->lba_count ? config->lba_count : info.block_count;
+
+    if (config->io_size % info.block_size != 0 || config->lba_start >= info.block_count ||
+        region > info.block_count - config->lba_start || region < count) {
+        ret = -EINVAL;
+        goto out;
+    }
+
+    state->slots = region / count;
+
+    for (unsigned long op = 0; op < ops; op++) {
+        unsigned long lba = config->lba_start + uboot_blkbench_slot(state, op) * count;
+        long done;
+
+        uint64_t start = get_ticks();
+        if (uboot_blkbench_is_write(config->workload))
+            done = uboot_blk_write(handle, lba, count, state->buffer);
+        else
+            done = uboot_blk_read(handle, lba, count, state->buffer);
+        uboot_latency_record(&state->latency, get_ticks() - start);
+
+        if (done != (long) count) {
+            ret = (done < 0) ? done : -EIO;
+            goto out;
+        }
+    }
+
+    // Data held back by a write-back cache is part of the cost of writing.
+    if (uboot_blkbench_is_write(config->workload))
+        ret = uboot_blk_flush(handle);
+
+out:
+    uboot_blk_close(handle);
+    return ret;
+}
+
+#ifdef CONFIG_HAVE_BLOCK_DEVICE
+
+static int uboot_blkbench_file_read(struct uboot_blkbench_state_t *state, unsigned long ops)
+{
+    const struct uboot_blk_bench_config *config = state->config;
+    int ret = 0;
+
+    struct uboot_fs_file *file = uboot_fs_open(config->iface, config->part, config->path);
+    if (file == NULL)
+        return -ENOENT;
+
+    state->slots = uboot_fs_size(file) / config->io_size;
+    if (state->slots == 0) {
+        ret = -EINVAL;
+        goto out;
+    }
+
+    for (unsigned long op = 0; op < ops; op++) {
+        uboot_fs_seek(file, (long long) uboot_blkbench_slot(state, op) * config->io_size,
+            UBOOT_FS_SEEK_SET);
+
+        uint64_t start = get_ticks();
+        long done = uboot_fs_read(file, state->buffer, config->io_size);
+        uboot_latency_record(&state->latency, get_ticks() - start);
+
+        if (done != (long) config->io_size) {
+            ret = (done < 0) ? done : -EIO;
+            goto out;
+        }
+    }
+
+out:
+    uboot_fs_close(file);
+    return ret;
+}
+
+static int uboot_blkbench_file_write(struct uboot_blkbench_state_t *state, unsigned long ops)
+{
+    const struct uboot_blk_bench_config *config = state->config;
+    loff_t size = 0;
+
+    // A sequential run writes the file afresh, a random run overwrites the
+    // existing contents of the file.
+    if (config->workload == UBOOT_BLK_BENCH_SEQ_WRITE) {
+        state->slots = ops;
+    } else {
+        uboot_fs_release();
+        if (fs_set_blk_dev(config->iface, config->part, FS_TYPE_ANY) != 0 ||
+            fs_size(config->path, &size) != 0)
+            return -ENOENT;
+        state->slots = size / config->io_size;
+        if (state->slots == 0)
+            return -EINVAL;
+    }
+
+    for (unsigned long op = 0; op < ops; op++) {
+        loff_t offset = (loff_t) uboot_blkbench_slot(state, op) * config->io_size;
+        loff_t done;
+
+        uint64_t start = get_ticks();
+        uboot_fs_release();
+        int ret = fs_set_blk_dev(config->iface, config->part, FS_TYPE_ANY);
+        if (ret == 0)
+            ret = fs_write(config->path, (ulong) state->buffer, offset, config->io_size, &done);
+        uboot_latency_record(&state->latency, get_ticks() - start);
+
+        // Not all filesystems write at an offset (ext4 does not).
+        if (ret != 0 || done != config->io_size)
+            return -EIO;
+    }
+
+    return uboot_blk_flush(NULL);
+}
+
+#else
+
+static int uboot_blkbench_file_read(struct uboot_blkbench_state_t *state,
+    unsigned long ops) { return -ENOSYS; }
+static int uboot_blkbench_file_write(struct uboot_blkbench_state_t *state,
+    unsigned long ops) { return -ENOSYS; }
+
+#endif
+
+int uboot_blk_bench_run(const struct uboot_blk_bench_config *config,
+    struct uboot_blk_bench_result *result)
+{
+    struct uboot_blkbench_state_t state;
+    int ret;
+
+    // Return immediately if library not initialised.
+    if (gd == NULL || gd->dm_root == NULL)
+        return -ENODEV;
+
+    if (config == NULL || result == NULL || config->iface == NULL || config->io_size == 0 ||
+        config->workload < UBOOT_BLK_BENCH_SEQ_READ ||
+        config->workload > UBOOT_BLK_BENCH_RAND_WRITE ||
+        (config->path != NULL && config->part == NULL))
+        return -EINVAL;
+
+    // Raw writes are confined to a region given explicitly, so that a
+    // mistaken configuration cannot overwrite a whole device.
+    if (config->path == NULL && uboot_blkbench_is_write(config->workload) &&
+        config->lba_count == 0)
+        return -EINVAL;
+
+    memset(result, 0, sizeof(*result));
+    memset(&state, 0, sizeof(state));
+    state.config = config;
+    state.random = config->seed ? config->seed : 1;
+
+    unsigned long ops = DIV_ROUND_UP(config->total, config->io_size);
+    if (ops == 0)
+        ops = 1;
+
+    state.buffer = malloc(config->io_size);
+    if (state.buffer == NULL)
+        return -ENOMEM;
+
+    // Write a recognisable pattern rather than whatever the heap held.
+    for (unsigned long i = 0; i < config->io_size; i++)
+        ((uint8_t *) state.buffer)[i] = i;
+
+    ulong start_us = timer_get_us();
+
+    if (config->path == NULL)
+        ret = uboot_blkbench_raw(&state, ops);
+    else if (uboot_blkbench_is_write(config->workload))
+        ret = uboot_blkbench_file_write(&state, ops);
+    else
+        ret = uboot_blkbench_file_read(&state, ops);
+
+    result->elapsed_us = timer_get_us() - start_us;
+
+    free(state.buffer);
+
+    if (ret < 0)
+        return ret;
+
+    result->operations = ops;
+    result->bytes = (unsigned long long) ops * config->io_size;
+    if (result->elapsed_us > 0)
+        result->kib_per_s = (result->bytes * 1000000ull / 1024) / result->elapsed_us;
+    result->p50_ns = uboot_latency_ticks_to_ns(uboot_latency_percentile(&state.latency, 50));
+    result->p90_ns = uboot_latency_ticks_to_ns(uboot_latency_percentile(&state.latency, 90));
+    result->p99_ns = uboot_latency_ticks_to_ns(uboot_latency_percentile(&state.latency, 99));
+    result->max_ns = uboot_latency_ticks_to_ns(state.latency.max);
+
+    return 0;
+}
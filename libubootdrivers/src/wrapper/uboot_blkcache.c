@@ -0,0 +1,898 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This file provides a read-ahead cache between the users of the blk uclass
+ * (filesystems, commands and the wrapper's block routines) and the block
+ * drivers, which it wraps in the same manner as the neighbour cache wraps
+ * the ethernet driver.
+ *
+ * The cache is fully associative, holding fixed size lines of consecutive
+ * blocks replaced in least recently used order. Reads continuing from where
+ * the previous read of a device ended are treated as sequential, and each
+ * miss of a sequential stream reads ahead a run of lines in one command,
+ * doubling the run up to a configured maximum. Requests at least as large as
+ * the maximum run are read directly into the caller's buffer.
+ *
+ * Writes pass through to the device unless write-back is configured, in
+ * which case small writes only update the cache, marking the blocks dirty.
+ * Dirty blocks are written when their line is evicted or the cache is
+ * flushed, adjacent dirty blocks being combined into a single command, so
+ * that metadata rewritten many times by a filesystem reaches the device
+ * once.
+ *
+ * Regions of a device may be pinned, such that lines holding them are only
+ * replaced by other pinned lines. The filesystem layer pins the allocation
+ * table of a FAT filesystem, so that cluster chains are followed without
+ * reading the device. At most half of the cache is pinned.
+ */
+
+#include <uboot_helper.h>
+#include <blk.h>
+#include <dm/device.h>
+#include <driver_data.h>
+#include <sel4_dma.h>
+#include <uboot_blkcache.h>
+#include "../../include/public_api/uboot_drivers.h"
+
+/* Default size of a cache line (bytes), number of lines, and the largest
+ * read ahead (bytes) */
+#define UBOOT_BLKCACHE_LINE_SIZE    (16 * 1024)
+#define UBOOT_BLKCACHE_LINES        64
+#define UBOOT_BLKCACHE_READAHEAD    (256 * 1024)
+
+/* Number of block drivers which may be wrapped, and of devices whose
+ * sequential streams are tracked */
+#define UBOOT_BLKCACHE_MAX_DRIVERS  4
+#define UBOOT_BLKCACHE_MAX_STREAMS  4
+
+/* Number of regions which may be pinned */
+#define UBOOT_BLKCACHE_MAX_PINS     4
+
+/* Smallest block size supported, which determines the size of the dirty
+ * block bitmap of each line */
+#define UBOOT_BLKCACHE_MIN_BLKSZ    512
+
+#define UBOOT_BLKCACHE_WORD_BITS    (8 * sizeof(unsigned long))
+
+struct uboot_blkcache_line_t {
+    bool valid;
+    struct udevice *dev;
+    int hwpart;
+    lbaint_t tag;               /* first block / blocks per line */
+    lbaint_t blocks;            /* blocks held, fewer at the end of a device */
+    unsigned long used;
+    uint8_t *data;
+    unsigned long *dirty;       /* bitmap of blocks not yet written */
+    lbaint_t dirty_count;
+    bool pinned;
+};
+
+struct uboot_blkcache_driver_t {
+    struct driver *drv;
+    const struct blk_ops *ops;
+    struct blk_ops interposed_ops;
+    int (*remove)(struct udevice *dev);
+};
+
+struct uboot_blkcache_pin_t {
+    struct udevice *dev;
+    int hwpart;
+    lbaint_t start;
+    lbaint_t count;
+};
+
+struct uboot_blkcache_stream_t {
+    struct udevice *dev;
+    lbaint_t next;              /* block following the last read */
+    unsigned int window;        /* lines to read on the next miss */
+};
+
+static struct uboot_blk_cache_config config = {
+    .line_size = UBOOT_BLKCACHE_LINE_SIZE,
+    .lines = UBOOT_BLKCACHE_LINES,
+    .readahead_max = UBOOT_BLKCACHE_READAHEAD,
+    .write_back = 0,
+};
+
+static struct uboot_blk_cache_stats stats;
+
+static struct uboot_blkcache_driver_t drivers[UBOOT_BLKCACHE_MAX_DRIVERS];
+static int driver_count;
+
+static struct uboot_blkcache_stream_t streams[UBOOT_BLKCACHE_MAX_STREAMS];
+static unsigned int next_stream;
+
+static struct uboot_blkcache_pin_t pins[UBOOT_BLKCACHE_MAX_PINS];
+
+/* Count of writes to any device and invalidations of the cache, by which
+ * users of the cache may detect that data derived from the contents of a
+ * device is stale */
+static unsigned long generation;
+
+/* Cache lines and their data, allocated on first use. Runs of lines read
+ * ahead or written back are staged through a single buffer. */
+static struct uboot_blkcache_line_t *lines;
+static struct sel4_dma_pool line_pool;
+static unsigned long *dirty_bitmaps;
+static uint8_t *staging;
+static unsigned long use_count;
+static unsigned int dirty_lines;
+static unsigned int pinned_lines;
+
+
+static struct uboot_blkcache_driver_t *uboot_blkcache_driver(struct udevice *dev)
+{
+    for (int i = 0; i < driver_count; i++)
+        if (dev->driver == drivers[i].drv)
+            return &drivers[i];
+
+    return NULL;
+}
+
+static const struct blk_ops *uboot_blkcache_driver_ops(struct udevice *dev)
+{
+    struct uboot_blkcache_driver_t *driver = uboot_blkcache_driver(dev);
+
+    return (driver != NULL) ? driver->ops : NULL;
+}
+
+static unsigned int uboot_blkcache_readahead_lines(void)
+{
+    unsigned int count = config.readahead_max / config.line_size;
+
+    // A run must not evict its own first line, and lines read ahead only
+    // replace lines not pinned.
+    if (count > config.lines - pinned_lines)
+        count = config.lines - pinned_lines;
+
+    return (count < 1) ? 1 : count;
+}
+
+static inline lbaint_t uboot_blkcache_per_line(struct udevice *dev)
+{
+    struct blk_desc *desc = dev_get_uclass_plat(dev);
+
+    return config.line_size / desc->blksz;
+}
+
+static inline bool uboot_blkcache_is_dirty(struct uboot_blkcache_line_t *line, lbaint_t block)
+{
+    return line->dirty[block / UBOOT_BLKCACHE_WORD_BITS] &
+        (1UL << (block % UBOOT_BLKCACHE_WORD_BITS));
+}
+
+static void uboot_blkcache_mark(struct uboot_blkcache_line_t *line, lbaint_t block,
+    lbaint_t count, bool dirty)
+{
+    bool was_dirty = line->dirty_count > 0;
+
+    for (lbaint_t b = block; b < block + count; b++) {
+        unsigned long mask = 1UL << (b % UBOOT_BLKCACHE_WORD_BITS);
+        unsigned long *word = &line->dirty[b / UBOOT_BLKCACHE_WORD_BITS];
+
+        if (dirty && !(*word & mask)) {
+            *word |= mask;
+            line->dirty_count++;
+        } else if (!dirty && (*word & mask)) {
+            *word &= ~mask;
+            line->dirty_count--;
+        }
+    }
+
+    if (!was_dirty && line->dirty_count > 0)
+        dirty_lines++;
+    else if (was_dirty && line->dirty_count == 0)
+        dirty_lines--;
+}
+
+static void uboot_blkcache_release(void)
+{
+    if (staging != NULL)
+        sel4_dma_free(staging);
+    staging = NULL;
+
+    sel4_dma_pool_destroy(&line_pool);
+
+    free(lines);
+    lines = NULL;
+    free(dirty_bitmaps);
+    dirty_bitmaps = NULL;
+    dirty_lines = 0;
+    pinned_lines = 0;
+}
+
+static bool uboot_blkcache_setup(void)
+{
+    if (lines != NULL)
+        return true;
+
+    if (config.lines == 0)
+        return false;
+
+    size_t words = DIV_ROUND_UP(config.line_size / UBOOT_BLKCACHE_MIN_BLKSZ,
+        UBOOT_BLKCACHE_WORD_BITS);
+
+    lines = calloc(config.lines, sizeof(*lines));
+    dirty_bitmaps = calloc(config.lines * words, sizeof(unsigned long));
+    staging = sel4_dma_memalign(ARCH_DMA_MINALIGN,
+        uboot_blkcache_readahead_lines() * config.line_size);
+    if (lines == NULL || dirty_bitmaps == NULL || staging == NULL ||
+        sel4_dma_pool_create(&line_pool, config.line_size, config.lines) != 0) {
+        UBOOT_LOGE("Unable to allocate block cache, continuing without");
+        uboot_blkcache_release();
+        config.lines = 0;
+        return false;
+    }
+
+    for (unsigned int i = 0; i < config.lines; i++) {
+        lines[i].data = sel4_dma_pool_alloc(&line_pool);
+        lines[i].dirty = &dirty_bitmaps[i * words];
+    }
+
+    return true;
+}
+
+static struct uboot_blkcache_line_t *uboot_blkcache_lookup(struct udevice *dev,
+    int hwpart, lbaint_t tag)
+{
+    for (unsigned int i = 0; i < config.lines; i++) {
+        struct uboot_blkcache_line_t *line = &lines[i];
+        if (line->valid && line->tag == tag && line->dev == dev && line->hwpart == hwpart)
+            return line;
+    }
+
+    return NULL;
+}
+
+static bool uboot_blkcache_in_pin(struct uboot_blkcache_line_t *line)
+{
+    lbaint_t per_line = uboot_blkcache_per_line(line->dev);
+    lbaint_t first = line->tag * per_line;
+
+    for (int i = 0; i < UBOOT_BLKCACHE_MAX_PINS; i++)
+        if (pins[i].count > 0 && pins[i].dev == line->dev && pins[i].hwpart == line->hwpart &&
+            first < pins[i].start + pins[i].count && pins[i].start < first + per_line)
+            return true;
+
+    return false;
+}
+
+static void uboot_blkcache_pin_line(struct uboot_blkcache_line_t *line)
+{
+    if (!line->pinned && pinned_lines < config.lines / 2 && uboot_blkcache_in_pin(line)) {
+        line->pinned = true;
+        pinned_lines++;
+    }
+}
+
+static void uboot_blkcache_drop(struct uboot_blkcache_line_t *line)
+{
+    if (line->pinned)
+        pinned_lines--;
+
+    line->pinned = false;
+    line->valid = false;
+}
+
+/* Write 'count' blocks from 'lba' of the given hardware partition, which
+ * need not be the one currently selected */
+static int uboot_blkcache_device_write(struct udevice *dev, int hwpart, lbaint_t lba,
+    lbaint_t count, const void *buffer)
+{
+    const struct blk_ops *ops = uboot_blkcache_driver_ops(dev);
+    struct blk_desc *desc = dev_get_uclass_plat(dev);
+    int selected = desc->hwpart;
+
+    if (hwpart != selected && blk_dselect_hwpart(desc, hwpart) != 0)
+        return -EIO;
+
+    stats.device_writes++;
+    ulong written = ops->write(dev, lba, count, buffer);
+
+    if (hwpart != selected)
+        blk_dselect_hwpart(desc, selected);
+
+    return (written == count) ? 0 : -EIO;
+}
+
+/* Write back the dirty blocks of a single line, a run at a time */
+static int uboot_blkcache_clean(struct uboot_blkcache_line_t *line)
+{
+    lbaint_t per_line = uboot_blkcache_per_line(line->dev);
+    lbaint_t blksz = config.line_size / per_line;
+    lbaint_t block = 0;
+
+    while (line->dirty_count > 0 && block < line->blocks) {
+        if (!uboot_blkcache_is_dirty(line, block)) {
+            block++;
+            continue;
+        }
+
+        lbaint_t end = block + 1;
+        while (end < line->blocks && uboot_blkcache_is_dirty(line, end))
+            end++;
+
+        int ret = uboot_blkcache_device_write(line->dev, line->hwpart,
+            line->tag * per_line + block, end - block, line->data + block * blksz);
+        if (ret < 0)
+            return ret;
+
+        uboot_blkcache_mark(line, block, end - block, false);
+        block = end;
+    }
+
+    return 0;
+}
+
+/* Select the least recently used line for replacement, not pinned unless
+ * 'pinned' is set, and write back its dirty blocks */
+static struct uboot_blkcache_line_t *uboot_blkcache_select(bool pinned)
+{
+    struct uboot_blkcache_line_t *victim = NULL;
+
+    for (unsigned int i = 0; i < config.lines; i++) {
+        if (!lines[i].valid)
+            return &lines[i];
+        if (lines[i].pinned && !pinned)
+            continue;
+        if (victim == NULL || lines[i].used < victim->used)
+            victim = &lines[i];
+    }
+
+    return victim;
+}
+
+static struct uboot_blkcache_line_t *uboot_blkcache_victim(void)
+{
+    // Fewer than half the lines are pinned, so there is always another.
+    struct uboot_blkcache_line_t *victim = uboot_blkcache_select(false);
+    if (victim == NULL)
+        victim = uboot_blkcache_select(true);
+
+    if (victim->valid && victim->dirty_count > 0 && uboot_blkcache_clean(victim) != 0) {
+        UBOOT_LOGE("Unable to write back block cache line");
+        return NULL;
+    }
+
+    uboot_blkcache_drop(victim);
+    return victim;
+}
+
+static void uboot_blkcache_claim(struct uboot_blkcache_line_t *line, struct udevice *dev,
+    lbaint_t tag, lbaint_t blocks)
+{
+    struct blk_desc *desc = dev_get_uclass_plat(dev);
+
+    line->valid = true;
+    line->dev = dev;
+    line->hwpart = desc->hwpart;
+    line->tag = tag;
+    line->blocks = blocks;
+    line->used = ++use_count;
+    uboot_blkcache_pin_line(line);
+}
+
+static struct uboot_blkcache_stream_t *uboot_blkcache_stream(struct udevice *dev)
+{
+    for (int i = 0; i < UBOOT_BLKCACHE_MAX_STREAMS; i++)
+        if (streams[i].dev == dev)
+            return &streams[i];
+
+    struct uboot_blkcache_stream_t *stream = &streams[next_stream];
+    next_stream = (next_stream + 1) % UBOOT_BLKCACHE_MAX_STREAMS;
+
+    stream->dev = dev;
+    stream->next = 0;
+    stream->window = 1;
+
+    return stream;
+}
+
+/* Read the line holding 'tag', together with up to 'window - 1' following
+ * lines not already cached */
+static struct uboot_blkcache_line_t *uboot_blkcache_fill(struct udevice *dev,
+    const struct blk_ops *ops, lbaint_t tag, unsigned int window)
+{
+    struct blk_desc *desc = dev_get_uclass_plat(dev);
+    lbaint_t per_line = config.line_size / desc->blksz;
+    lbaint_t first = tag * per_line;
+    unsigned int count = 1;
+
+    if (first >= desc->lba)
+        return NULL;
+
+    while (count < window && first + count * per_line < desc->lba &&
+        uboot_blkcache_lookup(dev, desc->hwpart, tag + count) == NULL)
+        count++;
+
+    lbaint_t blocks = count * per_line;
+    if (blocks > desc->lba - first)
+        blocks = desc->lba - first;
+
+    // A single line is read directly into its place in the cache.
+    struct uboot_blkcache_line_t *line = uboot_blkcache_victim();
+    if (line == NULL)
+        return NULL;
+    uint8_t *buffer = (count == 1) ? line->data : staging;
+
+    stats.device_reads++;
+    if (ops->read(dev, first, blocks, buffer) != blocks)
+        return NULL;
+
+    stats.misses++;
+    stats.prefetched += count - 1;
+
+    for (unsigned int i = 0; i < count; i++) {
+        // Lines read ahead are claimed as most recently used, so that they
+        // are not evicted to make room for the remainder of the run.
+        if (i > 0 && (line = uboot_blkcache_victim()) == NULL)
+            break;
+        if (buffer == staging)
+            memcpy(line->data, staging + i * config.line_size, config.line_size);
+
+        uboot_blkcache_claim(line, dev, tag + i,
+            min(blocks - i * per_line, per_line));
+    }
+
+    return uboot_blkcache_lookup(dev, desc->hwpart, tag);
+}
+
+/* Copy the dirty cached blocks of a range read directly from the device
+ * over the stale data read */
+static void uboot_blkcache_overlay(struct udevice *dev, lbaint_t start, lbaint_t count,
+    void *buffer)
+{
+    struct blk_desc *desc = dev_get_uclass_plat(dev);
+    lbaint_t per_line = config.line_size / desc->blksz;
+
+    for (unsigned int i = 0; dirty_lines > 0 && i < config.lines; i++) {
+        struct uboot_blkcache_line_t *line = &lines[i];
+        if (!line->valid || line->dirty_count == 0 || line->dev != dev ||
+            line->hwpart != desc->hwpart)
+            continue;
+
+        lbaint_t first = line->tag * per_line;
+        lbaint_t low = max(first, start);
+        lbaint_t high = min(first + line->blocks, start + count);
+
+        for (lbaint_t b = low; b < high; b++)
+            if (uboot_blkcache_is_dirty(line, b - first))
+                memcpy((uint8_t *) buffer + (b - start) * desc->blksz,
+                    line->data + (b - first) * desc->blksz, desc->blksz);
+    }
+}
+
+static ulong uboot_blkcache_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+    void *buffer)
+{
+    const struct blk_ops *ops = uboot_blkcache_driver_ops(dev);
+    struct blk_desc *desc = dev_get_uclass_plat(dev);
+    lbaint_t done = 0;
+
+    if (ops == NULL)
+        return 0;
+
+    struct uboot_blkcache_stream_t *stream = uboot_blkcache_stream(dev);
+    unsigned int max_window = uboot_blkcache_readahead_lines();
+
+    if (start == stream->next)
+        stream->window = (stream->window * 2 > max_window) ? max_window : stream->window * 2;
+    else
+        stream->window = 1;
+    stream->next = start + blkcnt;
+
+    if (!uboot_blkcache_setup() || desc->blksz > config.line_size ||
+        blkcnt * desc->blksz >= max_window * config.line_size) {
+        stats.bypassed++;
+        stats.device_reads++;
+        ulong blocks = ops->read(dev, start, blkcnt, buffer);
+        if (lines != NULL && blocks == blkcnt)
+            uboot_blkcache_overlay(dev, start, blkcnt, buffer);
+        return blocks;
+    }
+
+    lbaint_t per_line = config.line_size / desc->blksz;
+
+    while (done < blkcnt) {
+        lbaint_t lba = start + done;
+        lbaint_t offset = lba % per_line;
+
+        struct uboot_blkcache_line_t *line =
+            uboot_blkcache_lookup(dev, desc->hwpart, lba / per_line);
+        if (line != NULL)
+            stats.hits++;
+        else
+            line = uboot_blkcache_fill(dev, ops, lba / per_line, stream->window);
+
+        if (line == NULL || offset >= line->blocks)
+            break;
+
+        lbaint_t count = line->blocks - offset;
+        if (count > blkcnt - done)
+            count = blkcnt - done;
+
+        memcpy((uint8_t *) buffer + done * desc->blksz,
+            line->data + offset * desc->blksz, count * desc->blksz);
+        line->used = ++use_count;
+        done += count;
+    }
+
+    return done;
+}
+
+/* Apply 'count' blocks written from 'start' to any cached copy, or if
+ * 'buffer' is NULL remove them from the cache */
+static void uboot_blkcache_update(struct udevice *dev, lbaint_t start, lbaint_t count,
+    const void *buffer)
+{
+    struct blk_desc *desc = dev_get_uclass_plat(dev);
+
+    if (lines == NULL || desc->blksz > config.line_size)
+        return;
+
+    lbaint_t per_line = config.line_size / desc->blksz;
+
+    for (unsigned int i = 0; i < config.lines; i++) {
+        struct uboot_blkcache_line_t *line = &lines[i];
+        if (!line->valid || line->dev != dev || line->hwpart != desc->hwpart)
+            continue;
+
+        lbaint_t first = line->tag * per_line;
+        lbaint_t low = max(first, start);
+        lbaint_t high = min(first + line->blocks, start + count);
+        if (low >= high)
+            continue;
+
+        if (buffer != NULL) {
+            memcpy(line->data + (low - first) * desc->blksz,
+                (const uint8_t *) buffer + (low - start) * desc->blksz,
+                (high - low) * desc->blksz);
+            uboot_blkcache_mark(line, low - first, high - low, false);
+            continue;
+        }
+
+        // Dirty blocks of the line outside the range must reach the device
+        // before the line is dropped.
+        uboot_blkcache_mark(line, low - first, high - low, false);
+        if (line->dirty_count > 0 && uboot_blkcache_clean(line) != 0)
+            UBOOT_LOGE("Unable to write back block cache line");
+        uboot_blkcache_mark(line, 0, line->blocks, false);
+        uboot_blkcache_drop(line);
+    }
+}
+
+static ulong uboot_blkcache_write_back(struct udevice *dev, const struct blk_ops *ops,
+    lbaint_t start, lbaint_t blkcnt, const void *buffer)
+{
+    struct blk_desc *desc = dev_get_uclass_plat(dev);
+    lbaint_t per_line = config.line_size / desc->blksz;
+    lbaint_t done = 0;
+
+    while (done < blkcnt) {
+        lbaint_t lba = start + done;
+        lbaint_t tag = lba / per_line;
+        lbaint_t offset = lba % per_line;
+        lbaint_t count = min(per_line - offset, blkcnt - done);
+
+        struct uboot_blkcache_line_t *line = uboot_blkcache_lookup(dev, desc->hwpart, tag);
+        if (line == NULL) {
+            lbaint_t blocks = min(per_line, desc->lba - tag * per_line);
+
+            // A line overwritten in full need not be read first.
+            if (offset == 0 && count == blocks) {
+                line = uboot_blkcache_victim();
+                if (line != NULL)
+                    uboot_blkcache_claim(line, dev, tag, blocks);
+            } else {
+                line = uboot_blkcache_fill(dev, ops, tag, 1);
+            }
+        }
+
+        if (line == NULL || offset + count > line->blocks)
+            break;
+
+        memcpy(line->data + offset * desc->blksz,
+            (const uint8_t *) buffer + done * desc->blksz, count * desc->blksz);
+        uboot_blkcache_mark(line, offset, count, true);
+        line->used = ++use_count;
+        done += count;
+    }
+
+    stats.deferred_writes++;
+
+    return done;
+}
+
+static ulong uboot_blkcache_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+    const void *buffer)
+{
+    const struct blk_ops *ops = uboot_blkcache_driver_ops(dev);
+    struct blk_desc *desc = dev_get_uclass_plat(dev);
+
+    if (ops == NULL)
+        return 0;
+
+    generation++;
+
+    if (config.write_back && start < desc->lba && blkcnt <= desc->lba - start &&
+        uboot_blkcache_setup() && desc->blksz <= config.line_size &&
+        blkcnt * desc->blksz < uboot_blkcache_readahead_lines() * config.line_size)
+        return uboot_blkcache_write_back(dev, ops, start, blkcnt, buffer);
+
+    stats.device_writes++;
+    ulong written = ops->write(dev, start, blkcnt, buffer);
+
+    // Blocks beyond those written are in an unknown state.
+    uboot_blkcache_update(dev, start, written, buffer);
+    if (written < blkcnt)
+        uboot_blkcache_update(dev, start + written, blkcnt - written, NULL);
+
+    return written;
+}
+
+static ulong uboot_blkcache_erase(struct udevice *dev, lbaint_t start, lbaint_t blkcnt)
+{
+    const struct blk_ops *ops = uboot_blkcache_driver_ops(dev);
+    if (ops == NULL)
+        return 0;
+
+    generation++;
+    uboot_blkcache_update(dev, start, blkcnt, NULL);
+
+    return ops->erase(dev, start, blkcnt);
+}
+
+/* Select the dirty line (of 'dev' if not NULL) at which a run of dirty
+ * blocks begins, i.e. that earliest on its device and partition */
+static struct uboot_blkcache_line_t *uboot_blkcache_first_dirty(struct udevice *dev)
+{
+    struct uboot_blkcache_line_t *first = NULL;
+
+    for (unsigned int i = 0; i < config.lines; i++) {
+        struct uboot_blkcache_line_t *line = &lines[i];
+        if (!line->valid || line->dirty_count == 0 || (dev != NULL && line->dev != dev))
+            continue;
+
+        if (first == NULL)
+            first = line;
+        else if (line->dev == first->dev && line->hwpart == first->hwpart &&
+            line->tag < first->tag)
+            first = line;
+    }
+
+    return first;
+}
+
+int uboot_blkcache_flush(struct udevice *dev)
+{
+    if (lines == NULL)
+        return 0;
+
+    unsigned int max_lines = uboot_blkcache_readahead_lines();
+    struct uboot_blkcache_line_t *run[max_lines];
+    struct uboot_blkcache_line_t *line;
+
+    while (dirty_lines > 0 && (line = uboot_blkcache_first_dirty(dev)) != NULL) {
+        lbaint_t per_line = uboot_blkcache_per_line(line->dev);
+        lbaint_t blksz = config.line_size / per_line;
+        lbaint_t block = 0;
+
+        while (!uboot_blkcache_is_dirty(line, block))
+            block++;
+
+        // Gather the lines over which the run of dirty blocks extends, as
+        // many as fit the staging buffer.
+        unsigned int count = 0;
+        lbaint_t end = block;
+        run[count++] = line;
+        for (;;) {
+            struct uboot_blkcache_line_t *last = run[count - 1];
+            while (end < last->blocks && uboot_blkcache_is_dirty(last, end))
+                end++;
+            if (end < per_line || count == max_lines)
+                break;
+
+            struct uboot_blkcache_line_t *next =
+                uboot_blkcache_lookup(last->dev, last->hwpart, last->tag + 1);
+            if (next == NULL || !uboot_blkcache_is_dirty(next, 0))
+                break;
+
+            run[count++] = next;
+            end = 0;
+        }
+
+        const uint8_t *data = line->data + block * blksz;
+        if (count > 1) {
+            for (unsigned int i = 0; i < count; i++) {
+                lbaint_t from = (i == 0) ? block : 0;
+                lbaint_t to = (i == count - 1) ? end : per_line;
+                memcpy(staging + (i * per_line + from - block) * blksz,
+                    run[i]->data + from * blksz, (to - from) * blksz);
+            }
+            data = staging;
+        }
+
+        int ret = uboot_blkcache_device_write(line->dev, line->hwpart,
+            line->tag * per_line + block, (count - 1) * per_line + end - block, data);
+        if (ret < 0) {
+            UBOOT_LOGE("Unable to write back block cache");
+            return ret;
+        }
+
+        for (unsigned int i = 0; i < count; i++) {
+            lbaint_t from = (i == 0) ? block : 0;
+            lbaint_t to = (i == count - 1) ? end : per_line;
+            uboot_blkcache_mark(run[i], from, to - from, false);
+        }
+    }
+
+    return 0;
+}
+
+/* Called in place of the remove method of a wrapped driver, so that no line
+ * outlives its device */
+static int uboot_blkcache_device_remove(struct udevice *dev)
+{
+    struct uboot_blkcache_driver_t *driver = uboot_blkcache_driver(dev);
+
+    // The device can still be written, but whatever cannot is lost with it.
+    if (uboot_blkcache_flush(dev) != 0)
+        UBOOT_LOGW("Discarding data not written to removed device '%s'", dev->name);
+    uboot_blkcache_remove(dev);
+
+    if (driver != NULL && driver->remove != NULL)
+        return driver->remove(dev);
+
+    return 0;
+}
+
+void uboot_blkcache_interpose(void)
+{
+    for (int i = 0; i < _u_boot_driver_count; i++) {
+        struct driver *drv = &driver_data.driver_array[i];
+
+        if (drv->id != UCLASS_BLK || drv->ops == NULL)
+            continue;
+
+        if (driver_count == UBOOT_BLKCACHE_MAX_DRIVERS) {
+            UBOOT_LOGW("Block cache not interposed on driver '%s'", drv->name);
+            continue;
+        }
+
+        struct uboot_blkcache_driver_t *entry = &drivers[driver_count++];
+        entry->drv = drv;
+        entry->ops = drv->ops;
+        entry->interposed_ops = *entry->ops;
+        if (entry->ops->read)
+            entry->interposed_ops.read = uboot_blkcache_read;
+        if (entry->ops->write)
+            entry->interposed_ops.write = uboot_blkcache_write;
+        if (entry->ops->erase)
+            entry->interposed_ops.erase = uboot_blkcache_erase;
+        drv->ops = &entry->interposed_ops;
+        entry->remove = drv->remove;
+        drv->remove = uboot_blkcache_device_remove;
+    }
+}
+
+void uboot_blkcache_invalidate(void)
+{
+    for (unsigned int i = 0; lines != NULL && i < config.lines; i++) {
+        uboot_blkcache_mark(&lines[i], 0, lines[i].blocks, false);
+        uboot_blkcache_drop(&lines[i]);
+    }
+
+    // Pins are repeated by the filesystem layer on its next mount.
+    memset(streams, 0, sizeof(streams));
+    memset(pins, 0, sizeof(pins));
+    generation++;
+}
+
+int uboot_blkcache_pin(struct udevice *dev, lbaint_t start, lbaint_t count)
+{
+    struct blk_desc *desc = dev_get_uclass_plat(dev);
+    struct uboot_blkcache_pin_t *pin = NULL;
+
+    for (int i = 0; i < UBOOT_BLKCACHE_MAX_PINS; i++) {
+        if (pins[i].count > 0 && pins[i].dev == dev && pins[i].hwpart == desc->hwpart &&
+            pins[i].start == start && pins[i].count == count)
+            return 0;
+        if (pins[i].count == 0 && pin == NULL)
+            pin = &pins[i];
+    }
+
+    if (pin == NULL)
+        return -ENOSPC;
+
+    pin->dev = dev;
+    pin->hwpart = desc->hwpart;
+    pin->start = start;
+    pin->count = count;
+
+    // Pin any lines of the region already cached.
+    for (unsigned int i = 0; lines != NULL && i < config.lines; i++)
+        if (lines[i].valid)
+            uboot_blkcache_pin_line(&lines[i]);
+
+    return 0;
+}
+
+void uboot_blkcache_remove(struct udevice *dev)
+{
+    // Anything not written is lost with the device.
+    for (unsigned int i = 0; lines != NULL && i < config.lines; i++) {
+        if (lines[i].valid && lines[i].dev == dev) {
+            uboot_blkcache_mark(&lines[i], 0, lines[i].blocks, false);
+            uboot_blkcache_drop(&lines[i]);
+        }
+    }
+
+    for (int i = 0; i < UBOOT_BLKCACHE_MAX_STREAMS; i++)
+        if (streams[i].dev == dev)
+            memset(&streams[i], 0, sizeof(streams[i]));
+
+    for (int i = 0; i < UBOOT_BLKCACHE_MAX_PINS; i++)
+        if (pins[i].dev == dev)
+            memset(&pins[i], 0, sizeof(pins[i]));
+
+    generation++;
+}
+
+unsigned long uboot_blkcache_generation(void)
+{
+    return generation;
+}
+
+void uboot_blkcache_shutdown(void)
+{
+    uboot_blkcache_flush(NULL);
+    uboot_blkcache_release();
+    memset(streams, 0, sizeof(streams));
+    memset(pins, 0, sizeof(pins));
+}
+
+int uboot_blk_cache_configure(const struct uboot_blk_cache_config *new_config)
+{
+    struct uboot_blk_cache_config defaults = {
+        .line_size = UBOOT_BLKCACHE_LINE_SIZE,
+        .lines = UBOOT_BLKCACHE_LINES,
+        .readahead_max = UBOOT_BLKCACHE_READAHEAD,
+        .write_back = 0,
+    };
+
+    if (new_config == NULL)
+        new_config = &defaults;
+
+    // Lines must hold a whole number of blocks of any size up to 4K.
+    if (new_config->lines > 0 &&
+        (new_config->line_size < 4096 || new_config->line_size % 4096 != 0))
+        return -EINVAL;
+
+    // Nothing written may be lost in reconfiguring.
+    int ret = uboot_blkcache_flush(NULL);
+    if (ret < 0)
+        return ret;
+
+    uboot_blkcache_shutdown();
+    config = *new_config;
+
+    return 0;
+}
+
+int uboot_blk_cache_get_stats(struct uboot_blk_cache_stats *out)
+{
+    if (out == NULL)
+        return -EINVAL;
+
+    *out = stats;
+    out->dirty_lines = dirty_lines;
+
+    return 0;
+}
+
+void uboot_blk_cache_reset_stats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
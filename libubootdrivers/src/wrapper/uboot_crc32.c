@@ -0,0 +1,41 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This file provides U-Boot's CRC-32 routines, in place of lib/crc32.c, using
+ * the kernels of libutils. These use the CRC32 instructions where available
+ * rather than a byte at a time table lookup, which benefits the verification
+ * of images and files as well as the network stack.
+ */
+
+#include <uboot_helper.h>
+#include <asm/byteorder.h>
+#include <u-boot/crc.h>
+#include <utils/checksum.h>
+
+uint32_t crc32(uint32_t crc, const unsigned char *p, uint len)
+{
+    return crc32_update(crc, p, len);
+}
+
+uint32_t crc32_no_comp(uint32_t crc, const unsigned char *p, uint len)
+{
+    // As crc32, without the complement of the initial and final values.
+    return ~crc32_update(~crc, p, len);
+}
+
+uint32_t crc32_wd(uint32_t crc, const unsigned char *buf, uint len, uint chunk_sz)
+{
+    // There is no watchdog to service between chunks, so the buffer is
+    // processed in one pass.
+    return crc32_update(crc, buf, len);
+}
+
+void crc32_wd_buf(const unsigned char *input, uint ilen, unsigned char *output,
+    uint chunk_sz)
+{
+    uint32_t crc = htonl(crc32_wd(0, input, ilen, chunk_sz));
+
+    memcpy(output, &crc, sizeof(crc));
+}
@@ -0,0 +1,466 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This file provides streaming access to files through U-Boot's generic
+ * filesystem layer. Rather than loading a whole file into a single buffer,
+ * as the 'load' commands do, a file is read a chunk at a time into buffers
+ * supplied by the caller, from a position which may be set at will.
+ *
+ * U-Boot's filesystems keep no state between operations, each looking up
+ * the path afresh. The sizes of files opened are therefore held in a hashed
+ * index, so that reopening a file needs no lookup, and the allocation table
+ * of a FAT filesystem is pinned in the block cache, so that the cluster
+ * chains followed by each read are found in memory. Any write to a block
+ * device, or U-Boot command, invalidates the index and the filesystems
+ * examined, as either changes the generation of the block cache.
+ *
+ * An ext4 file is read through the ext4 driver directly, and held open
+ * between reads so that its inode is decoded once rather than for every
+ * chunk. The driver merges contiguous blocks of the file into one read of
+ * the device, which for a large chunk bypasses the block cache.
+ */
+
+#include <uboot_helper.h>
+#include <fs.h>
+#include <blk.h>
+#include <part.h>
+#include <ext4fs.h>
+#include <asm/global_data.h>
+#include <uboot_blkcache.h>
+#include <uboot_fs.h>
+#include "../../include/public_api/uboot_drivers.h"
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#ifdef CONFIG_HAVE_BLOCK_DEVICE
+
+/* Maximum number of files open at once */
+#define UBOOT_FS_MAX_FILES      8
+
+#define UBOOT_FS_MAX_IFACE      8
+#define UBOOT_FS_MAX_PART       16
+#define UBOOT_FS_MAX_PATH       256
+
+/* Number of filesystems whose layout is remembered */
+#define UBOOT_FS_MAX_MOUNTS     4
+
+/* Number of sets in the index of file sizes, and entries in each set */
+#define UBOOT_FS_INDEX_SETS     32
+#define UBOOT_FS_INDEX_WAYS     4
+
+/* Largest block size of a device holding a FAT filesystem */
+#define UBOOT_FS_MAX_BLKSZ      4096
+
+struct uboot_fs_file {
+    bool open;
+    char iface[UBOOT_FS_MAX_IFACE];
+    char part[UBOOT_FS_MAX_PART];
+    char path[UBOOT_FS_MAX_PATH];
+    loff_t size;
+    loff_t pos;
+    bool ext4;
+};
+
+struct uboot_fs_mount_t {
+    bool valid;
+    char iface[UBOOT_FS_MAX_IFACE];
+    char part[UBOOT_FS_MAX_PART];
+    unsigned long generation;
+    struct udevice *dev;
+    /* blocks of the allocation table, none if not FAT */
+    lbaint_t fat_start;
+    lbaint_t fat_count;
+    bool ext4;
+};
+
+struct uboot_fs_index_entry_t {
+    bool valid;
+    uint32_t hash;
+    unsigned long generation;
+    unsigned long used;
+    char iface[UBOOT_FS_MAX_IFACE];
+    char part[UBOOT_FS_MAX_PART];
+    char path[UBOOT_FS_MAX_PATH];
+    loff_t size;
+};
+
+static struct uboot_fs_file files[UBOOT_FS_MAX_FILES];
+
+static struct uboot_fs_mount_t mounts[UBOOT_FS_MAX_MOUNTS];
+static unsigned int next_mount;
+
+static struct uboot_fs_index_entry_t name_index[UBOOT_FS_INDEX_SETS][UBOOT_FS_INDEX_WAYS];
+static unsigned long index_use_count;
+
+static uint8_t boot_sector[UBOOT_FS_MAX_BLKSZ] __aligned(ARCH_DMA_MINALIGN);
+
+/* File held open in the ext4 driver, and the block cache generation at
+ * which it was opened */
+static struct uboot_fs_file *held;
+static unsigned long held_generation;
+
+
+static bool uboot_fs_valid(struct uboot_fs_file *file)
+{
+    return file >= &files[0] && file < &files[UBOOT_FS_MAX_FILES] && file->open;
+}
+
+void uboot_fs_release(void)
+{
+    if (held == NULL)
+        return;
+
+    fs_close();
+    held = NULL;
+}
+
+/* Select the device and partition holding the file. The generic layer
+ * forgets the selection after each operation, so this precedes every one. */
+static int uboot_fs_select(struct uboot_fs_file *file)
+{
+    uboot_fs_release();
+
+    return fs_set_blk_dev(file->iface, file->part, FS_TYPE_ANY) ? -ENODEV : 0;
+}
+
+#ifdef CONFIG_FS_EXT4
+/* Open the file in the ext4 driver, unless already held open and not since
+ * written */
+static int uboot_fs_hold(struct uboot_fs_file *file)
+{
+    loff_t size;
+
+    if (held == file && held_generation == uboot_blkcache_generation())
+        return 0;
+
+    uboot_fs_release();
+
+    if (fs_set_blk_dev(file->iface, file->part, FS_TYPE_EXT) != 0)
+        return -ENODEV;
+
+    if (ext4fs_open(file->path, &size) < 0) {
+        fs_close();
+        return -ENOENT;
+    }
+
+    held = file;
+    held_generation = uboot_blkcache_generation();
+
+    return 0;
+}
+#endif
+
+static inline unsigned int uboot_fs_le16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t uboot_fs_le32(const uint8_t *p)
+{
+    return uboot_fs_le16(p) | ((uint32_t) uboot_fs_le16(p + 2) << 16);
+}
+
+/* Locate the first allocation table of a FAT filesystem from its boot
+ * sector, leaving the count zero for any other filesystem */
+static void uboot_fs_parse_fat(struct uboot_fs_mount_t *mount, struct blk_desc *desc,
+    lbaint_t start)
+{
+    const uint8_t *bs = boot_sector;
+
+    if (desc->blksz > sizeof(boot_sector) || blk_dread(desc, start, 1, boot_sector) != 1)
+        return;
+
+    if (bs[510] != 0x55 || bs[511] != 0xaa ||
+        (memcmp(&bs[0x36], "FAT", 3) != 0 && memcmp(&bs[0x52], "FAT", 3) != 0))
+        return;
+
+    unsigned int sector_size = uboot_fs_le16(&bs[0x0b]);
+    unsigned int reserved = uboot_fs_le16(&bs[0x0e]);
+    uint32_t fat_length = uboot_fs_le16(&bs[0x16]);
+
+    // FAT32 records the table length in its extended boot record.
+    if (fat_length == 0)
+        fat_length = uboot_fs_le32(&bs[0x24]);
+
+    if (sector_size < desc->blksz || sector_size % desc->blksz != 0 || fat_length == 0)
+        return;
+
+    mount->fat_start = start + (lbaint_t) reserved * (sector_size / desc->blksz);
+    mount->fat_count = (lbaint_t) fat_length * (sector_size / desc->blksz);
+}
+
+/* Recognise an ext2/3/4 filesystem by the magic number of its superblock,
+ * 1024 bytes from the start of the partition */
+static bool uboot_fs_is_ext4(struct blk_desc *desc, lbaint_t start)
+{
+    if (desc->blksz > sizeof(boot_sector) ||
+        blk_dread(desc, start + 1024 / desc->blksz, 1, boot_sector) != 1)
+        return false;
+
+    return uboot_fs_le16(&boot_sector[1024 % desc->blksz + 0x38]) == 0xef53;
+}
+
+/* Find the filesystem holding the file, examining it on first use or after
+ * its device was written or replaced, and pin any allocation table in the
+ * block cache */
+static struct uboot_fs_mount_t *uboot_fs_mount(struct uboot_fs_file *file)
+{
+    unsigned long generation = uboot_blkcache_generation();
+    struct uboot_fs_mount_t *mount = NULL;
+
+    for (int i = 0; i < UBOOT_FS_MAX_MOUNTS && mount == NULL; i++)
+        if (mounts[i].valid && strcmp(mounts[i].iface, file->iface) == 0 &&
+            strcmp(mounts[i].part, file->part) == 0)
+            mount = &mounts[i];
+
+    if (mount == NULL || mount->generation != generation) {
+        struct blk_desc *desc;
+        struct disk_partition info;
+
+        if (mount == NULL) {
+            mount = &mounts[next_mount];
+            next_mount = (next_mount + 1) % UBOOT_FS_MAX_MOUNTS;
+        }
+
+        memset(mount, 0, sizeof(*mount));
+        if (blk_get_device_part_str(file->iface, file->part, &desc, &info, 1) < 0)
+            return NULL;
+
+        strcpy(mount->iface, file->iface);
+        strcpy(mount->part, file->part);
+        mount->dev = desc->bdev;
+        uboot_fs_parse_fat(mount, desc, info.start);
+        if (mount->fat_count == 0)
+            mount->ext4 = uboot_fs_is_ext4(desc, info.start);
+        mount->generation = uboot_blkcache_generation();
+        mount->valid = true;
+    }
+
+    // Pinning is repeated as the block cache forgets pins on reconfiguration
+    // and invalidation.
+    if (mount->fat_count > 0 &&
+        uboot_blkcache_pin(mount->dev, mount->fat_start, mount->fat_count) != 0)
+        UBOOT_LOGD("Allocation table of %s %s not pinned", mount->iface, mount->part);
+
+    return mount;
+}
+
+static uint32_t uboot_fs_hash(struct uboot_fs_file *file)
+{
+    const char *strings[] = { file->iface, file->part, file->path };
+    uint32_t hash = 2166136261u;
+
+    for (int i = 0; i < ARRAY_SIZE(strings); i++)
+        for (const char *c = strings[i]; ; c++) {
+            hash = (hash ^ (uint8_t) *c) * 16777619u;
+            if (*c == 0)
+                break;
+        }
+
+    return hash;
+}
+
+static struct uboot_fs_index_entry_t *uboot_fs_index_lookup(struct uboot_fs_file *file,
+    uint32_t hash)
+{
+    struct uboot_fs_index_entry_t *set = name_index[hash % UBOOT_FS_INDEX_SETS];
+    unsigned long generation = uboot_blkcache_generation();
+
+    for (int i = 0; i < UBOOT_FS_INDEX_WAYS; i++) {
+        if (!set[i].valid || set[i].hash != hash || strcmp(set[i].path, file->path) != 0 ||
+            strcmp(set[i].iface, file->iface) != 0 || strcmp(set[i].part, file->part) != 0)
+            continue;
+
+        // Anything written, or a different medium, may have changed the
+        // file or its directory.
+        if (set[i].generation != generation) {
+            set[i].valid = false;
+            return NULL;
+        }
+
+        set[i].used = ++index_use_count;
+        return &set[i];
+    }
+
+    return NULL;
+}
+
+static void uboot_fs_index_update(struct uboot_fs_file *file, uint32_t hash)
+{
+    struct uboot_fs_index_entry_t *set = name_index[hash % UBOOT_FS_INDEX_SETS];
+    struct uboot_fs_index_entry_t *victim = &set[0];
+
+    for (int i = 0; i < UBOOT_FS_INDEX_WAYS; i++) {
+        if (!set[i].valid) {
+            victim = &set[i];
+            break;
+        }
+        if (set[i].used < victim->used)
+            victim = &set[i];
+    }
+
+    victim->valid = true;
+    victim->hash = hash;
+    victim->generation = uboot_blkcache_generation();
+    victim->used = ++index_use_count;
+    strcpy(victim->iface, file->iface);
+    strcpy(victim->part, file->part);
+    strcpy(victim->path, file->path);
+    victim->size = file->size;
+}
+
+struct uboot_fs_file *uboot_fs_open(const char *iface, const char *part, const char *path)
+{
+    struct uboot_fs_file *file = NULL;
+
+    // Return immediately if library not initialised.
+    if (gd == NULL || gd->dm_root == NULL)
+        return NULL;
+
+    if (iface == NULL || part == NULL || path == NULL ||
+        strlen(iface) >= UBOOT_FS_MAX_IFACE || strlen(part) >= UBOOT_FS_MAX_PART ||
+        strlen(path) >= UBOOT_FS_MAX_PATH)
+        return NULL;
+
+    for (int i = 0; i < UBOOT_FS_MAX_FILES && file == NULL; i++)
+        if (!files[i].open)
+            file = &files[i];
+
+    if (file == NULL) {
+        UBOOT_LOGE("Too many open files");
+        return NULL;
+    }
+
+    strcpy(file->iface, iface);
+    strcpy(file->part, part);
+    strcpy(file->path, path);
+    file->pos = 0;
+
+    struct uboot_fs_mount_t *mount = uboot_fs_mount(file);
+#ifdef CONFIG_FS_EXT4
+    file->ext4 = mount != NULL && mount->ext4;
+#else
+    file->ext4 = false;
+#endif
+
+    uint32_t hash = uboot_fs_hash(file);
+    struct uboot_fs_index_entry_t *entry = uboot_fs_index_lookup(file, hash);
+    if (entry != NULL) {
+        file->size = entry->size;
+    } else {
+        if (uboot_fs_select(file) != 0 || fs_size(file->path, &file->size) != 0)
+            return NULL;
+        uboot_fs_index_update(file, hash);
+    }
+
+    file->open = true;
+
+    return file;
+}
+
+long uboot_fs_read(struct uboot_fs_file *file, void *buffer, unsigned long length)
+{
+    loff_t actread;
+
+    if (!uboot_fs_valid(file) || buffer == NULL)
+        return -EINVAL;
+
+    // A length of zero would ask the filesystem for the whole file.
+    if (file->pos >= file->size || length == 0)
+        return 0;
+
+    if (length > file->size - file->pos)
+        length = file->size - file->pos;
+
+#ifdef CONFIG_FS_EXT4
+    if (file->ext4) {
+        int ret = uboot_fs_hold(file);
+        if (ret < 0)
+            return ret;
+
+        if (ext4fs_read(buffer, file->pos, length, &actread) != 0) {
+            uboot_fs_release();
+            return -EIO;
+        }
+
+        file->pos += actread;
+        return actread;
+    }
+#endif
+
+    if (uboot_fs_select(file) != 0)
+        return -ENODEV;
+
+    if (fs_read(file->path, (ulong) buffer, file->pos, length, &actread) != 0)
+        return -EIO;
+
+    file->pos += actread;
+
+    return actread;
+}
+
+long long uboot_fs_seek(struct uboot_fs_file *file, long long offset, int whence)
+{
+    loff_t pos;
+
+    if (!uboot_fs_valid(file))
+        return -EINVAL;
+
+    switch (whence) {
+    case UBOOT_FS_SEEK_SET:
+        pos = offset;
+        break;
+    case UBOOT_FS_SEEK_CUR:
+        pos = file->pos + offset;
+        break;
+    case UBOOT_FS_SEEK_END:
+        pos = file->size + offset;
+        break;
+    default:
+        return -EINVAL;
+    }
+
+    // Reads beyond the end of the file return nothing, as for a read
+    // reaching the end.
+    if (pos < 0)
+        return -EINVAL;
+
+    file->pos = pos;
+
+    return pos;
+}
+
+long long uboot_fs_size(struct uboot_fs_file *file)
+{
+    if (!uboot_fs_valid(file))
+        return -EINVAL;
+
+    return file->size;
+}
+
+void uboot_fs_close(struct uboot_fs_file *file)
+{
+    if (!uboot_fs_valid(file))
+        return;
+
+    if (held == file)
+        uboot_fs_release();
+
+    file->open = false;
+}
+
+#else
+
+struct uboot_fs_file *uboot_fs_open(const char *iface, const char *part,
+    const char *path) { return NULL; }
+long uboot_fs_read(struct uboot_fs_file *file, void *buffer,
+    unsigned long length) { return -ENOSYS; }
+long long uboot_fs_seek(struct uboot_fs_file *file, long long offset,
+    int whence) { return -ENOSYS; }
+long long uboot_fs_size(struct uboot_fs_file *file) { return -ENOSYS; }
+void uboot_fs_close(struct uboot_fs_file *file) {}
+void uboot_fs_release(void) {}
+
+#endif
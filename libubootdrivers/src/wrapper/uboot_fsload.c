@@ -0,0 +1,491 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This file loads a compressed file into memory, decompressing it as it is
+ * read. The file is read a chunk at a time through the streaming file
+ * routines and each chunk decompressed into the destination buffer while it
+ * is still in the processor's caches, rather than the whole compressed file
+ * first being loaded to a second buffer and then decompressed from memory.
+ *
+ * Two formats are understood: the LZ4 frame format, decoded here as it is
+ * fast enough to keep pace with the card, and gzip, inflated by U-Boot's
+ * zlib. A file in neither format is loaded as is.
+ */
+
+#include <uboot_helper.h>
+#include <fs.h>
+#include <time.h>
+#include <u-boot/crc.h>
+#include <u-boot/zlib.h>
+#include <asm/global_data.h>
+#include "../../include/public_api/uboot_drivers.h"
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#ifdef CONFIG_HAVE_BLOCK_DEVICE
+
+/* Bytes of the file read at a time */
+#define UBOOT_FSLOAD_CHUNK      (256 * 1024)
+
+#define LZ4_FRAME_MAGIC         0x184d2204
+#define LZ4_FLG_VERSION         0x40
+#define LZ4_FLG_BLOCK_CHECKSUM  0x10
+#define LZ4_FLG_CONTENT_SIZE    0x08
+#define LZ4_FLG_DICT_ID         0x01
+#define LZ4_BLOCK_UNCOMPRESSED  0x80000000
+#define LZ4_MIN_MATCH           4
+
+#define GZIP_FLG_HCRC           0x02
+#define GZIP_FLG_EXTRA          0x04
+#define GZIP_FLG_NAME           0x08
+#define GZIP_FLG_COMMENT        0x10
+
+struct uboot_fsload_state_t {
+    struct uboot_fs_file *file;
+    struct uboot_fs_load_stats *stats;
+    /* data read from the file, of which 'start' to 'end' is unconsumed */
+    uint8_t *input;
+    size_t input_size;
+    size_t start;
+    size_t end;
+    bool eof;
+    uint8_t *output;
+    unsigned long output_size;
+    unsigned long produced;
+};
+
+
+static inline uint32_t uboot_fsload_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+/* Read from the file until at least 'want' bytes are unconsumed, failing
+ * if the file ends first */
+static int uboot_fsload_fill(struct uboot_fsload_state_t *state, size_t want)
+{
+    if (want > state->input_size)
+        return -EPROTO;
+
+    while (state->end - state->start < want) {
+        if (state->eof)
+            return -EPROTO;
+
+        if (state->start > 0) {
+            memmove(state->input, state->input + state->start, state->end - state->start);
+            state->end -= state->start;
+            state->start = 0;
+        }
+
+        unsigned long length = min(state->input_size - state->end,
+            (size_t) UBOOT_FSLOAD_CHUNK);
+
+        ulong start_us = timer_get_us();
+        long ret = uboot_fs_read(state->file, state->input + state->end, length);
+        state->stats->read_us += timer_get_us() - start_us;
+
+        if (ret < 0)
+            return ret;
+        if (ret == 0)
+            state->eof = true;
+
+        state->end += ret;
+        state->stats->file_bytes += ret;
+    }
+
+    return 0;
+}
+
+/* Decode an LZ4 block, appending to the output. Matches may refer to any
+ * earlier output, so blocks need not be independent. */
+static int uboot_fsload_lz4_block(struct uboot_fsload_state_t *state, const uint8_t *ip,
+    size_t length)
+{
+    const uint8_t *iend = ip + length;
+    uint8_t *op = state->output + state->produced;
+    uint8_t *oend = state->output + state->output_size;
+
+    for (;;) {
+        if (ip >= iend)
+            return -EPROTO;
+
+        unsigned int token = *ip++;
+        size_t literals = token >> 4;
+        size_t match;
+
+        if (literals == 15) {
+            unsigned int b;
+            do {
+                if (ip >= iend)
+                    return -EPROTO;
+                b = *ip++;
+                literals += b;
+            } while (b == 255);
+        }
+
+        if ((ptrdiff_t) literals > iend - ip)
+            return -EPROTO;
+        if ((ptrdiff_t) literals > oend - op)
+            return -EFBIG;
+        memcpy(op, ip, literals);
+        ip += literals;
+        op += literals;
+
+        // The last sequence holds literals alone.
+        if (ip == iend)
+            break;
+
+        if (iend - ip < 2)
+            return -EPROTO;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || (ptrdiff_t) offset > op - state->output)
+            return -EPROTO;
+
+        match = token & 15;
+        if (match == 15) {
+            unsigned int b;
+            do {
+                if (ip >= iend)
+                    return -EPROTO;
+                b = *ip++;
+                match += b;
+            } while (b == 255);
+        }
+        match += LZ4_MIN_MATCH;
+
+        if ((ptrdiff_t) match > oend - op)
+            return -EFBIG;
+
+        // A match overlapping its own output repeats the last 'offset'
+        // bytes, so must be copied in order.
+        const uint8_t *ref = op - offset;
+        if (offset >= match) {
+            memcpy(op, ref, match);
+            op += match;
+        } else {
+            while (match-- > 0)
+                *op++ = *ref++;
+        }
+    }
+
+    state->produced = op - state->output;
+    return 0;
+}
+
+static int uboot_fsload_lz4(struct uboot_fsload_state_t *state)
+{
+    int ret = uboot_fsload_fill(state, 7);
+    if (ret < 0)
+        return ret;
+
+    const uint8_t *header = state->input + state->start;
+    unsigned int flg = header[4];
+    unsigned int bd = header[5];
+    unsigned int block_id = (bd >> 4) & 7;
+
+    // Dictionaries are not supported, nor is any other version.
+    if (uboot_fsload_le32(header) != LZ4_FRAME_MAGIC || (flg & 0xc0) != LZ4_FLG_VERSION ||
+        (flg & LZ4_FLG_DICT_ID) || block_id < 4)
+        return -EPROTO;
+
+    size_t header_length = 7 + ((flg & LZ4_FLG_CONTENT_SIZE) ? 8 : 0);
+    size_t block_max = 1 << (2 * block_id + 8);
+    size_t checksum_length = (flg & LZ4_FLG_BLOCK_CHECKSUM) ? 4 : 0;
+
+    ret = uboot_fsload_fill(state, header_length);
+    if (ret < 0)
+        return ret;
+
+    // Reject a file which cannot fit before reading any more of it.
+    if (flg & LZ4_FLG_CONTENT_SIZE) {
+        uint64_t content = uboot_fsload_le32(state->input + state->start + 6) |
+            ((uint64_t) uboot_fsload_le32(state->input + state->start + 10) << 32);
+        if (content > state->output_size)
+            return -EFBIG;
+    }
+    state->start += header_length;
+
+    // Room for a whole block, its size and checksum, beyond a chunk.
+    size_t input_size = UBOOT_FSLOAD_CHUNK + block_max + 8;
+    uint8_t *input = realloc(state->input, input_size);
+    if (input == NULL)
+        return -ENOMEM;
+    state->input = input;
+    state->input_size = input_size;
+
+    for (;;) {
+        ret = uboot_fsload_fill(state, 4);
+        if (ret < 0)
+            return ret;
+
+        uint32_t size = uboot_fsload_le32(state->input + state->start);
+        state->start += 4;
+
+        // The end mark, which may be followed by a content checksum.
+        if (size == 0)
+            return 0;
+
+        bool uncompressed = size & LZ4_BLOCK_UNCOMPRESSED;
+        size &= ~LZ4_BLOCK_UNCOMPRESSED;
+        if (size > block_max)
+            return -EPROTO;
+
+        ret = uboot_fsload_fill(state, size + checksum_length);
+        if (ret < 0)
+            return ret;
+
+        ulong start_us = timer_get_us();
+        if (uncompressed) {
+            if (size > state->output_size - state->produced)
+                return -EFBIG;
+            memcpy(state->output + state->produced, state->input + state->start, size);
+            state->produced += size;
+        } else {
+            ret = uboot_fsload_lz4_block(state, state->input + state->start, size);
+        }
+        state->stats->decompress_us += timer_get_us() - start_us;
+
+        if (ret < 0)
+            return ret;
+
+        state->start += size + checksum_length;
+    }
+}
+
+/* Skip a zero terminated field of a gzip header */
+static int uboot_fsload_gzip_skip_string(struct uboot_fsload_state_t *state, size_t *pos)
+{
+    for (;;) {
+        int ret = uboot_fsload_fill(state, *pos + 1);
+        if (ret < 0)
+            return ret;
+        if (state->input[state->start + (*pos)++] == 0)
+            return 0;
+    }
+}
+
+static void *uboot_fsload_zalloc(void *opaque, unsigned int items, unsigned int size)
+{
+    return malloc((size_t) items * size);
+}
+
+static void uboot_fsload_zfree(void *opaque, void *address, unsigned int bytes)
+{
+    free(address);
+}
+
+static int uboot_fsload_gzip(struct uboot_fsload_state_t *state)
+{
+    size_t pos = 10;
+    z_stream stream;
+    int ret;
+
+    ret = uboot_fsload_fill(state, pos);
+    if (ret < 0)
+        return ret;
+
+    const uint8_t *header = state->input + state->start;
+    unsigned int flags = header[3];
+
+    if (header[0] != 0x1f || header[1] != 0x8b || header[2] != Z_DEFLATED)
+        return -EPROTO;
+
+    if (flags & GZIP_FLG_EXTRA) {
+        ret = uboot_fsload_fill(state, pos + 2);
+        if (ret < 0)
+            return ret;
+        pos += 2 + (state->input[state->start + pos] |
+            (state->input[state->start + pos + 1] << 8));
+    }
+    if ((flags & GZIP_FLG_NAME) && (ret = uboot_fsload_gzip_skip_string(state, &pos)) < 0)
+        return ret;
+    if ((flags & GZIP_FLG_COMMENT) && (ret = uboot_fsload_gzip_skip_string(state, &pos)) < 0)
+        return ret;
+    if (flags & GZIP_FLG_HCRC)
+        pos += 2;
+
+    ret = uboot_fsload_fill(state, pos);
+    if (ret < 0)
+        return ret;
+    state->start += pos;
+
+    // The header is handled here, so inflate the raw deflate stream.
+    memset(&stream, 0, sizeof(stream));
+    stream.zalloc = uboot_fsload_zalloc;
+    stream.zfree = uboot_fsload_zfree;
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+        return -ENOMEM;
+
+    stream.next_out = state->output;
+    stream.avail_out = min(state->output_size, (unsigned long) UINT_MAX);
+
+    for (;;) {
+        if (state->start == state->end) {
+            ret = uboot_fsload_fill(state, 1);
+            if (ret < 0)
+                break;
+        }
+
+        stream.next_in = state->input + state->start;
+        stream.avail_in = state->end - state->start;
+
+        ulong start_us = timer_get_us();
+        int zret = inflate(&stream, Z_NO_FLUSH);
+        state->stats->decompress_us += timer_get_us() - start_us;
+
+        state->start = stream.next_in - state->input;
+
+        if (zret == Z_STREAM_END) {
+            ret = 0;
+            break;
+        }
+        if (zret == Z_BUF_ERROR && stream.avail_out == 0) {
+            ret = -EFBIG;
+            break;
+        }
+        if (zret != Z_OK && zret != Z_BUF_ERROR) {
+            ret = -EPROTO;
+            break;
+        }
+    }
+
+    state->produced = stream.total_out;
+    inflateEnd(&stream);
+
+    if (ret < 0)
+        return ret;
+
+    // The trailer holds the CRC and length of the uncompressed data.
+    ret = uboot_fsload_fill(state, 8);
+    if (ret < 0)
+        return ret;
+
+    ulong start_us = timer_get_us();
+    uint32_t crc = crc32(0, state->output, state->produced);
+    state->stats->decompress_us += timer_get_us() - start_us;
+
+    if (crc != uboot_fsload_le32(state->input + state->start) ||
+        (uint32_t) state->produced != uboot_fsload_le32(state->input + state->start + 4))
+        return -EPROTO;
+
+    return 0;
+}
+
+static int uboot_fsload_detect(struct uboot_fsload_state_t *state)
+{
+    // Too short to be compressed.
+    if (uboot_fsload_fill(state, 4) < 0)
+        return UBOOT_FS_CODEC_NONE;
+
+    const uint8_t *magic = state->input + state->start;
+
+    if (uboot_fsload_le32(magic) == LZ4_FRAME_MAGIC)
+        return UBOOT_FS_CODEC_LZ4;
+    if (magic[0] == 0x1f && magic[1] == 0x8b)
+        return UBOOT_FS_CODEC_GZIP;
+
+    return UBOOT_FS_CODEC_NONE;
+}
+
+/* Load the file as is, in a single read as the 'load' commands do */
+static int uboot_fsload_plain(struct uboot_fsload_state_t *state)
+{
+    long long size = uboot_fs_size(state->file);
+
+    if (size < 0)
+        return size;
+    if ((unsigned long long) size > state->output_size)
+        return -EFBIG;
+
+    uboot_fs_seek(state->file, 0, UBOOT_FS_SEEK_SET);
+
+    ulong start_us = timer_get_us();
+    long ret = uboot_fs_read(state->file, state->output, size);
+    state->stats->read_us += timer_get_us() - start_us;
+
+    if (ret < 0)
+        return ret;
+    if (ret != size)
+        return -EIO;
+
+    state->stats->file_bytes = size;
+    state->produced = size;
+
+    return 0;
+}
+
+long uboot_fs_load(const char *iface, const char *part, const char *path, int codec,
+    void *buffer, unsigned long buffer_size, struct uboot_fs_load_stats *stats)
+{
+    struct uboot_fs_load_stats local_stats;
+    struct uboot_fsload_state_t state;
+    int ret;
+
+    // Return immediately if library not initialised.
+    if (gd == NULL || gd->dm_root == NULL)
+        return -ENODEV;
+
+    if (buffer == NULL || codec < UBOOT_FS_CODEC_AUTO || codec > UBOOT_FS_CODEC_GZIP)
+        return -EINVAL;
+
+    if (stats == NULL)
+        stats = &local_stats;
+    memset(stats, 0, sizeof(*stats));
+
+    ulong start_us = timer_get_us();
+
+    memset(&state, 0, sizeof(state));
+    state.stats = stats;
+    state.output = buffer;
+    state.output_size = buffer_size;
+
+    state.file = uboot_fs_open(iface, part, path);
+    if (state.file == NULL)
+        return -ENOENT;
+
+    state.input_size = UBOOT_FSLOAD_CHUNK;
+    state.input = malloc(state.input_size);
+    if (state.input == NULL) {
+        uboot_fs_close(state.file);
+        return -ENOMEM;
+    }
+
+    if (codec == UBOOT_FS_CODEC_AUTO)
+        codec = uboot_fsload_detect(&state);
+    stats->codec = codec;
+
+    switch (codec) {
+    case UBOOT_FS_CODEC_LZ4:
+        ret = uboot_fsload_lz4(&state);
+        break;
+    case UBOOT_FS_CODEC_GZIP:
+#ifdef CONFIG_ZLIB
+        ret = uboot_fsload_gzip(&state);
+#else
+        ret = -ENOSYS;
+#endif
+        break;
+    default:
+        ret = uboot_fsload_plain(&state);
+        break;
+    }
+
+    free(state.input);
+    uboot_fs_close(state.file);
+
+    stats->loaded_bytes = state.produced;
+    stats->elapsed_us = timer_get_us() - start_us;
+
+    return (ret < 0) ? ret : (long) state.produced;
+}
+
+#else
+
+long uboot_fs_load(const char *iface, const char *part, const char *path, int codec,
+    void *buffer, unsigned long buffer_size,
+    struct uboot_fs_load_stats *stats) { return -ENOSYS; }
+
+#endif
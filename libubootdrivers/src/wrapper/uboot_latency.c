@@ -0,0 +1,50 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ */
+
+#include <uboot_helper.h>
+#include <time.h>
+#include <uboot_latency.h>
+
+void uboot_latency_record(struct uboot_latency *latency, uint64_t ticks)
+{
+    // Bucket 'n' holds samples of bit length 'n', i.e. [2^(n-1), 2^n - 1].
+    unsigned int bucket = (ticks == 0) ? 0 : 64 - __builtin_clzll(ticks);
+
+    latency->buckets[bucket]++;
+    latency->count++;
+    if (ticks > latency->max)
+        latency->max = ticks;
+}
+
+uint64_t uboot_latency_percentile(const struct uboot_latency *latency, unsigned int percent)
+{
+    if (latency->count == 0)
+        return 0;
+
+    // Rank of the sample at the requested percentile, rounding up.
+    unsigned long rank = DIV_ROUND_UP((uint64_t) latency->count * percent, 100);
+    unsigned long seen = 0;
+
+    for (int bucket = 0; bucket < UBOOT_LATENCY_BUCKETS; bucket++) {
+        seen += latency->buckets[bucket];
+        if (seen >= rank) {
+            uint64_t bound = (bucket == 64) ? ~0ull : (1ull << bucket) - 1;
+            return min(bound, latency->max);
+        }
+    }
+
+    return latency->max;
+}
+
+unsigned long uboot_latency_ticks_to_ns(uint64_t ticks)
+{
+    // Split the conversion to avoid overflow for large tick counts.
+    uint64_t frequency = get_tbclk();
+
+    return (ticks / frequency) * 1000000000ull +
+        ((ticks % frequency) * 1000000000ull) / frequency;
+}
@@ -0,0 +1,266 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This file provides a cache of resolved IPv4 neighbours. Entries are held
+ * in a set associative hash table and expire a fixed time after they were
+ * last confirmed.
+ *
+ * The cache is shared with U-Boot's network commands by wrapping the
+ * operations of the ethernet driver: received ARP traffic is learnt, and an
+ * ARP request sent by U-Boot for a cached address is answered with a reply
+ * synthesised from the cache, which is returned by the next receive. The
+ * command therefore proceeds without waiting on the network.
+ */
+
+#include <uboot_helper.h>
+#include <dm/device.h>
+#include <net.h>
+#include <driver_data.h>
+#include <uboot_neigh.h>
+
+#ifdef CONFIG_DM_ETH
+
+/* Number of sets in the cache, and entries in each set */
+#define UBOOT_NEIGH_SETS        32
+#define UBOOT_NEIGH_WAYS        4
+
+/* Time (ms) for which an entry remains valid once confirmed */
+#define UBOOT_NEIGH_TIMEOUT_MS  120000
+
+struct uboot_neigh_entry_t {
+    bool valid;
+    struct in_addr ip;
+    u8 ethaddr[ARP_HLEN];
+    ulong updated;
+};
+
+static struct uboot_neigh_entry_t cache[UBOOT_NEIGH_SETS][UBOOT_NEIGH_WAYS];
+
+/* Operations of the wrapped ethernet driver, and the wrapper in their place */
+static const struct eth_ops *driver_ops;
+static struct eth_ops interposed_ops;
+
+/* Reply synthesised in response to an ARP request for a cached address */
+static uchar arp_reply[ETHER_HDR_SIZE + ARP_HDR_SIZE] __aligned(ARCH_DMA_MINALIGN);
+static bool arp_reply_pending;
+
+
+static inline unsigned int uboot_neigh_set(struct in_addr ip)
+{
+    return (ntohl(ip.s_addr) * 2654435761u) >> 27;
+}
+
+static inline bool uboot_neigh_expired(struct uboot_neigh_entry_t *entry, ulong now)
+{
+    return now - entry->updated > UBOOT_NEIGH_TIMEOUT_MS;
+}
+
+bool uboot_neigh_lookup(struct in_addr ip, u8 *ethaddr)
+{
+    struct uboot_neigh_entry_t *set = cache[uboot_neigh_set(ip)];
+    ulong now = get_timer(0);
+
+    for (int i = 0; i < UBOOT_NEIGH_WAYS; i++) {
+        if (!set[i].valid || set[i].ip.s_addr != ip.s_addr)
+            continue;
+
+        if (uboot_neigh_expired(&set[i], now)) {
+            set[i].valid = false;
+            return false;
+        }
+
+        memcpy(ethaddr, set[i].ethaddr, ARP_HLEN);
+        return true;
+    }
+
+    return false;
+}
+
+void uboot_neigh_update(struct in_addr ip, const u8 *ethaddr)
+{
+    struct uboot_neigh_entry_t *set = cache[uboot_neigh_set(ip)];
+    struct uboot_neigh_entry_t *victim = NULL;
+    ulong now = get_timer(0);
+
+    if (ip.s_addr == 0 || is_zero_ethaddr(ethaddr) || is_multicast_ethaddr(ethaddr))
+        return;
+
+    // Refresh an existing entry.
+    for (int i = 0; i < UBOOT_NEIGH_WAYS && victim == NULL; i++)
+        if (set[i].valid && set[i].ip.s_addr == ip.s_addr)
+            victim = &set[i];
+
+    // Otherwise replace an invalid or expired entry, or failing that the
+    // least recently confirmed.
+    for (int i = 0; i < UBOOT_NEIGH_WAYS && victim == NULL; i++)
+        if (!set[i].valid || uboot_neigh_expired(&set[i], now))
+            victim = &set[i];
+
+    if (victim == NULL) {
+        victim = &set[0];
+        for (int i = 1; i < UBOOT_NEIGH_WAYS; i++)
+            if (now - set[i].updated > now - victim->updated)
+                victim = &set[i];
+    }
+
+    victim->valid = true;
+    victim->ip = ip;
+    memcpy(victim->ethaddr, ethaddr, ARP_HLEN);
+    victim->updated = now;
+}
+
+void uboot_neigh_forget(struct in_addr ip)
+{
+    struct uboot_neigh_entry_t *set = cache[uboot_neigh_set(ip)];
+
+    for (int i = 0; i < UBOOT_NEIGH_WAYS; i++)
+        if (set[i].valid && set[i].ip.s_addr == ip.s_addr)
+            set[i].valid = false;
+}
+
+bool uboot_neigh_announce(struct ethernet_hdr *et, struct arp_hdr *arp)
+{
+    struct in_addr ip = net_read_ip(&arp->ar_spa);
+    bool gratuitous = ip.s_addr == net_read_ip(&arp->ar_tpa).s_addr;
+
+    if (ip.s_addr == 0 || (!gratuitous && ntohs(arp->ar_op) != ARPOP_REPLY))
+        return false;
+
+    // The sender's address replaces any cached, unless the frame contradicts
+    // itself, in which case nothing is known of the address.
+    if (memcmp(et->et_src, &arp->ar_sha, ARP_HLEN) != 0 ||
+        is_zero_ethaddr(&arp->ar_sha) || is_multicast_ethaddr(&arp->ar_sha))
+        uboot_neigh_forget(ip);
+    else
+        uboot_neigh_update(ip, &arp->ar_sha);
+
+    return true;
+}
+
+void uboot_neigh_flush(void)
+{
+    memset(cache, 0, sizeof(cache));
+    arp_reply_pending = false;
+}
+
+static void uboot_neigh_learn(uchar *packet, int length)
+{
+    struct ethernet_hdr *et = (struct ethernet_hdr *) packet;
+    struct arp_hdr *arp = (struct arp_hdr *)(packet + ETHER_HDR_SIZE);
+
+    if (length < ETHER_HDR_SIZE + ARP_HDR_SIZE || ntohs(et->et_protlen) != PROT_ARP ||
+        ntohs(arp->ar_hrd) != ARP_ETHER || ntohs(arp->ar_pro) != PROT_IP ||
+        arp->ar_hln != ARP_HLEN || arp->ar_pln != ARP_PLEN)
+        return;
+
+    // Learn from replies and announcements, and from requests directed at us.
+    if (uboot_neigh_announce(et, arp))
+        return;
+
+    if (net_ip.s_addr != 0 && net_read_ip(&arp->ar_tpa).s_addr == net_ip.s_addr)
+        uboot_neigh_update(net_read_ip(&arp->ar_spa), &arp->ar_sha);
+}
+
+static bool uboot_neigh_answer(uchar *packet, int length)
+{
+    struct ethernet_hdr *et = (struct ethernet_hdr *) packet;
+    struct arp_hdr *arp = (struct arp_hdr *)(packet + ETHER_HDR_SIZE);
+    u8 ethaddr[ARP_HLEN];
+
+    if (length < ETHER_HDR_SIZE + ARP_HDR_SIZE || ntohs(et->et_protlen) != PROT_ARP ||
+        ntohs(arp->ar_op) != ARPOP_REQUEST || arp_reply_pending)
+        return false;
+
+    if (!uboot_neigh_lookup(net_read_ip(&arp->ar_tpa), ethaddr))
+        return false;
+
+    // Build the reply the neighbour would have sent.
+    struct ethernet_hdr *reply_et = (struct ethernet_hdr *) arp_reply;
+    struct arp_hdr *reply = (struct arp_hdr *)(arp_reply + ETHER_HDR_SIZE);
+
+    memcpy(reply_et->et_dest, et->et_src, ARP_HLEN);
+    memcpy(reply_et->et_src, ethaddr, ARP_HLEN);
+    reply_et->et_protlen = htons(PROT_ARP);
+
+    reply->ar_hrd = htons(ARP_ETHER);
+    reply->ar_pro = htons(PROT_IP);
+    reply->ar_hln = ARP_HLEN;
+    reply->ar_pln = ARP_PLEN;
+    reply->ar_op = htons(ARPOP_REPLY);
+    memcpy(&reply->ar_sha, ethaddr, ARP_HLEN);
+    net_copy_ip(&reply->ar_spa, &arp->ar_tpa);
+    memcpy(&reply->ar_tha, &arp->ar_sha, ARP_HLEN);
+    net_copy_ip(&reply->ar_tpa, &arp->ar_spa);
+
+    arp_reply_pending = true;
+
+    return true;
+}
+
+static int uboot_neigh_send(struct udevice *dev, void *packet, int length)
+{
+    if (uboot_neigh_answer(packet, length))
+        return 0;
+
+    return driver_ops->send(dev, packet, length);
+}
+
+static int uboot_neigh_recv(struct udevice *dev, int flags, uchar **packetp)
+{
+    if (arp_reply_pending) {
+        arp_reply_pending = false;
+        *packetp = arp_reply;
+        return sizeof(arp_reply);
+    }
+
+    int ret = driver_ops->recv(dev, flags, packetp);
+    if (ret > 0)
+        uboot_neigh_learn(*packetp, ret);
+
+    return ret;
+}
+
+static int uboot_neigh_free_pkt(struct udevice *dev, uchar *packet, int length)
+{
+    if (packet == arp_reply)
+        return 0;
+
+    if (driver_ops->free_pkt)
+        return driver_ops->free_pkt(dev, packet, length);
+
+    return 0;
+}
+
+void uboot_neigh_interpose(void)
+{
+    driver_ops = NULL;
+    arp_reply_pending = false;
+
+    for (int i = 0; i < _u_boot_driver_count; i++) {
+        struct driver *drv = &driver_data.driver_array[i];
+
+        if (drv->id != UCLASS_ETH || drv->ops == NULL)
+            continue;
+
+        // The loopback device of the TFTP benchmark stands in for the
+        // network, so answers ARP itself.
+        if (strcmp(drv->name, "uboot_tftp_loopback_eth") == 0)
+            continue;
+
+        if (driver_ops != NULL) {
+            UBOOT_LOGW("Neighbour cache not interposed on driver '%s'", drv->name);
+            return;
+        }
+
+        driver_ops = drv->ops;
+        interposed_ops = *driver_ops;
+        interposed_ops.send = uboot_neigh_send;
+        interposed_ops.recv = uboot_neigh_recv;
+        interposed_ops.free_pkt = uboot_neigh_free_pkt;
+        drv->ops = &interposed_ops;
+    }
+}
+
+#endif
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This file provides a block device held in memory. It stands in for an SD
+ * card or USB drive where none is available, and gives a baseline free of
+ * device latency against which changes to the block layer can be measured.
+ *
+ * Ramdisks are bound as devices of the "host" interface, so are reached by
+ * the block, filesystem and U-Boot commands as e.g. "host 0", and are read
+ * and written through the block cache in the same way as any other device.
+ */
+
+#include <uboot_helper.h>
+#include <blk.h>
+#include <dm/device.h>
+#include <dm/device-internal.h>
+#include <dm/root.h>
+#include <asm/global_data.h>
+#include <uboot_blkcache.h>
+#include "../../include/public_api/uboot_drivers.h"
+
+DECLARE_GLOBAL_DATA_PTR;
+
+struct uboot_ramdisk_plat {
+    uint8_t *data;
+};
+
+
+static lbaint_t uboot_ramdisk_clamp(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt)
+{
+    if (start >= desc->lba)
+        return 0;
+
+    return min(blkcnt, desc->lba - start);
+}
+
+static ulong uboot_ramdisk_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+    void *buffer)
+{
+    struct blk_desc *desc = dev_get_uclass_plat(dev);
+    struct uboot_ramdisk_plat *plat = dev_get_plat(dev);
+
+    blkcnt = uboot_ramdisk_clamp(desc, start, blkcnt);
+    memcpy(buffer, plat->data + start * desc->blksz, blkcnt * desc->blksz);
+
+    return blkcnt;
+}
+
+static ulong uboot_ramdisk_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+    const void *buffer)
+{
+    struct blk_desc *desc = dev_get_uclass_plat(dev);
+    struct uboot_ramdisk_plat *plat = dev_get_plat(dev);
+
+    blkcnt = uboot_ramdisk_clamp(desc, start, blkcnt);
+    memcpy(plat->data + start * desc->blksz, buffer, blkcnt * desc->blksz);
+
+    return blkcnt;
+}
+
+static ulong uboot_ramdisk_erase(struct udevice *dev, lbaint_t start, lbaint_t blkcnt)
+{
+    struct blk_desc *desc = dev_get_uclass_plat(dev);
+    struct uboot_ramdisk_plat *plat = dev_get_plat(dev);
+
+    blkcnt = uboot_ramdisk_clamp(desc, start, blkcnt);
+    memset(plat->data + start * desc->blksz, 0, blkcnt * desc->blksz);
+
+    return blkcnt;
+}
+
+static int uboot_ramdisk_remove(struct udevice *dev)
+{
+    struct uboot_ramdisk_plat *plat = dev_get_plat(dev);
+
+    free(plat->data);
+    plat->data = NULL;
+
+    return 0;
+}
+
+static const struct blk_ops uboot_ramdisk_ops = {
+    .read = uboot_ramdisk_read,
+    .write = uboot_ramdisk_write,
+    .erase = uboot_ramdisk_erase,
+};
+
+U_BOOT_DRIVER(uboot_ramdisk_blk) = {
+    .name = "uboot_ramdisk_blk",
+    .id = UCLASS_BLK,
+    .ops = &uboot_ramdisk_ops,
+    .remove = uboot_ramdisk_remove,
+    .plat_auto = sizeof(struct uboot_ramdisk_plat),
+};
+
+int uboot_ramdisk_create(unsigned long block_size, unsigned long block_count)
+{
+    struct udevice *dev;
+    int ret;
+
+    // Return immediately if library not initialised.
+    if (gd == NULL || gd->dm_root == NULL)
+        return -ENODEV;
+
+    if (block_size < 512 || block_size > 4096 || (block_size & (block_size - 1)) != 0 ||
+        block_count == 0)
+        return -EINVAL;
+
+    uint8_t *data = calloc(block_count, block_size);
+    if (data == NULL)
+        return -ENOMEM;
+
+    // Take the next free device number of the interface.
+    ret = blk_create_devicef(dm_root(), "uboot_ramdisk_blk", "ramdisk", IF_TYPE_HOST, -1,
+        block_size, block_count, &dev);
+    if (ret < 0) {
+        free(data);
+        return ret;
+    }
+
+    struct uboot_ramdisk_plat *plat = dev_get_plat(dev);
+    plat->data = data;
+
+    ret = device_probe(dev);
+    if (ret < 0) {
+        device_unbind(dev);
+        free(data);
+        return ret;
+    }
+
+    struct blk_desc *desc = dev_get_uclass_plat(dev);
+    UBOOT_LOGI("Created ramdisk host %d of %lu blocks of %lu bytes", desc->devnum,
+        block_count, block_size);
+
+    return desc->devnum;
+}
+
+int uboot_ramdisk_destroy(int devnum)
+{
+    struct udevice *dev;
+
+    // Return immediately if library not initialised.
+    if (gd == NULL || gd->dm_root == NULL)
+        return -ENODEV;
+
+    // The operations may be wrapped by the block cache, so the driver is
+    // recognised by name.
+    if (blk_get_device(IF_TYPE_HOST, devnum, &dev) != 0 ||
+        strcmp(dev->driver->name, "uboot_ramdisk_blk") != 0)
+        return -ENODEV;
+
+    uboot_blkcache_remove(dev);
+
+    int ret = device_remove(dev, DM_REMOVE_NORMAL);
+    if (ret < 0)
+        return ret;
+
+    return device_unbind(dev);
+}
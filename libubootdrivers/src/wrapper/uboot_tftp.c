@@ -0,0 +1,368 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This file provides a TFTP client built on the wrapper's UDP routines,
+ * independent of U-Boot's 'tftp' command. The block size (RFC 2348) and
+ * window size (RFC 7440) are negotiated with the server so that a window of
+ * blocks is acknowledged at once rather than each block in turn. Data is
+ * streamed directly into a buffer supplied by the caller, or passed to a
+ * callback as each block arrives.
+ */
+
+#include <uboot_helper.h>
+#include <net.h>
+#include <uboot_udp.h>
+#include "../../include/public_api/uboot_drivers.h"
+
+#ifdef CONFIG_DM_ETH
+
+#define TFTP_PORT               69
+
+#define TFTP_RRQ                1
+#define TFTP_DATA               3
+#define TFTP_ACK                4
+#define TFTP_ERROR              5
+#define TFTP_OACK               6
+
+/* Block and window sizes requested when the caller does not specify one */
+#define UBOOT_TFTP_BLKSIZE      CONFIG_TFTP_BLOCKSIZE
+#define UBOOT_TFTP_WINDOWSIZE   8
+
+/* Largest block which fits a single ethernet frame */
+#define UBOOT_TFTP_MAX_BLKSIZE  1468
+
+/* Time (ms) waited for a packet before retransmitting, and the number of
+ * consecutive retransmissions before giving up */
+#define UBOOT_TFTP_TIMEOUT_MS   1000
+#define UBOOT_TFTP_RETRIES      5
+
+/* Source port of the first transfer */
+#define UBOOT_TFTP_LOCAL_PORT   49152
+
+struct uboot_tftp_state_t {
+    const struct uboot_tftp_request *request;
+    struct uboot_tftp_stats *stats;
+    int socket;
+    uint32_t server_ip;
+    uint16_t server_port;
+    bool server_known;
+    bool negotiated;
+    unsigned int blksize;
+    unsigned int windowsize;
+    /* Last block received in order, those received since last acked, and
+     * whether a gap after it has already been acknowledged */
+    uint16_t block;
+    unsigned int unacked;
+    bool gap_acked;
+    unsigned long offset;
+};
+
+static uint16_t local_port = UBOOT_TFTP_LOCAL_PORT;
+
+/* Packet buffers, sized for the largest block */
+static uchar tftp_tx[512];
+static uchar tftp_rx[4 + UBOOT_TFTP_MAX_BLKSIZE];
+
+
+static int uboot_tftp_put_option(uchar *p, int space, const char *name, unsigned long value)
+{
+    int length = snprintf((char *) p, space, "%s%c%lu", name, 0, value);
+
+    return (length < 0 || length + 1 > space) ? -ENAMETOOLONG : length + 1;
+}
+
+static int uboot_tftp_send_request(struct uboot_tftp_state_t *state)
+{
+    const char *filename = state->request->filename;
+    int length = 2;
+    int ret;
+
+    tftp_tx[0] = 0;
+    tftp_tx[1] = TFTP_RRQ;
+
+    int name_len = strlen(filename);
+    if (name_len + 1 + sizeof("octet") > sizeof(tftp_tx) - length)
+        return -ENAMETOOLONG;
+    memcpy(&tftp_tx[length], filename, name_len + 1);
+    length += name_len + 1;
+    memcpy(&tftp_tx[length], "octet", sizeof("octet"));
+    length += sizeof("octet");
+
+    ret = uboot_tftp_put_option(&tftp_tx[length], sizeof(tftp_tx) - length,
+        "blksize", state->blksize);
+    if (ret < 0)
+        return ret;
+    length += ret;
+
+    ret = uboot_tftp_put_option(&tftp_tx[length], sizeof(tftp_tx) - length,
+        "windowsize", state->windowsize);
+    if (ret < 0)
+        return ret;
+    length += ret;
+
+    // Ask for the transfer size so that an undersized buffer is rejected up
+    // front rather than part way through.
+    ret = uboot_tftp_put_option(&tftp_tx[length], sizeof(tftp_tx) - length,
+        "tsize", 0);
+    if (ret < 0)
+        return ret;
+    length += ret;
+
+    uint16_t port = state->request->server_port ? state->request->server_port : TFTP_PORT;
+    ret = uboot_udp_sendto(state->socket, tftp_tx, length, state->request->server_ip, port);
+
+    return (ret < 0) ? ret : 0;
+}
+
+static int uboot_tftp_send_ack(struct uboot_tftp_state_t *state)
+{
+    tftp_tx[0] = 0;
+    tftp_tx[1] = TFTP_ACK;
+    tftp_tx[2] = state->block >> 8;
+    tftp_tx[3] = state->block & 0xff;
+
+    state->unacked = 0;
+
+    int ret = uboot_udp_sendto(state->socket, tftp_tx, 4, state->server_ip,
+        state->server_port);
+
+    return (ret < 0) ? ret : 0;
+}
+
+static int uboot_tftp_parse_oack(struct uboot_tftp_state_t *state, int length)
+{
+    char *p = (char *) &tftp_rx[2];
+    char *end = (char *) &tftp_rx[length];
+    unsigned int requested_blksize = state->blksize;
+    unsigned int requested_windowsize = state->windowsize;
+
+    // The server may only lower the sizes requested (RFC 2348, RFC 7440).
+    // Options not acknowledged by the server revert to their defaults.
+    state->blksize = 512;
+    state->windowsize = 1;
+    state->negotiated = true;
+
+    while (p < end) {
+        char *name = p;
+        char *value = memchr(name, 0, end - name);
+        if (value == NULL || ++value >= end)
+            return -EPROTO;
+        char *next = memchr(value, 0, end - value);
+        if (next == NULL)
+            return -EPROTO;
+
+        unsigned long v = simple_strtoul(value, NULL, 10);
+
+        if (strcasecmp(name, "blksize") == 0) {
+            if (v < 8 || v > requested_blksize)
+                return -EPROTO;
+            state->blksize = v;
+        } else if (strcasecmp(name, "windowsize") == 0) {
+            if (v < 1 || v > requested_windowsize)
+                return -EPROTO;
+            state->windowsize = v;
+        } else if (strcasecmp(name, "tsize") == 0) {
+            if (state->request->buffer != NULL && v > state->request->buffer_size) {
+                UBOOT_LOGE("File size %lu exceeds buffer size %lu", v,
+                    state->request->buffer_size);
+                return -EFBIG;
+            }
+        }
+
+        p = next + 1;
+    }
+
+    return 0;
+}
+
+static int uboot_tftp_deliver(struct uboot_tftp_state_t *state, const uchar *data, int length)
+{
+    const struct uboot_tftp_request *request = state->request;
+
+    if (request->buffer != NULL) {
+        if (state->offset + length > request->buffer_size)
+            return -EFBIG;
+        memcpy((uchar *) request->buffer + state->offset, data, length);
+    } else if (request->callback != NULL) {
+        int ret = request->callback(request->cookie, data, state->offset, length);
+        if (ret < 0)
+            return ret;
+    }
+
+    state->offset += length;
+    return 0;
+}
+
+static int uboot_tftp_transfer(struct uboot_tftp_state_t *state)
+{
+    int retries = 0;
+    ulong start = get_timer(0);
+    int ret;
+
+    ret = uboot_tftp_send_request(state);
+    if (ret < 0)
+        return ret;
+
+    for (;;) {
+        uint32_t ip;
+        uint16_t port;
+
+        int length = uboot_udp_recvfrom(state->socket, tftp_rx, sizeof(tftp_rx), &ip, &port);
+        if (length < 0)
+            return length;
+
+        if (length == 0) {
+            if (get_timer(start) < UBOOT_TFTP_TIMEOUT_MS)
+                continue;
+
+            if (++retries > UBOOT_TFTP_RETRIES) {
+                UBOOT_LOGE("Timeout waiting for TFTP server");
+                return -ETIMEDOUT;
+            }
+
+            // Repeat whichever of the request or last acknowledgement was
+            // lost, prompting the server to resend from that point.
+            state->stats->retransmits++;
+            ret = state->server_known ? uboot_tftp_send_ack(state) :
+                uboot_tftp_send_request(state);
+            if (ret < 0)
+                return ret;
+
+            start = get_timer(0);
+            continue;
+        }
+
+        if (length < 4)
+            continue;
+
+        // The server responds from a new port, which identifies the transfer.
+        if (!state->server_known) {
+            if (ip != state->request->server_ip)
+                continue;
+            state->server_ip = ip;
+            state->server_port = port;
+            state->server_known = true;
+        } else if (ip != state->server_ip || port != state->server_port) {
+            continue;
+        }
+
+        uint16_t opcode = (tftp_rx[0] << 8) | tftp_rx[1];
+        uint16_t block = (tftp_rx[2] << 8) | tftp_rx[3];
+
+        switch (opcode) {
+        case TFTP_OACK:
+            ret = uboot_tftp_parse_oack(state, length);
+            if (ret < 0)
+                return ret;
+            ret = uboot_tftp_send_ack(state);
+            if (ret < 0)
+                return ret;
+            break;
+
+        case TFTP_DATA:
+            // A server without option support sends data straight away,
+            // using the default block and window sizes.
+            if (!state->negotiated) {
+                state->blksize = 512;
+                state->windowsize = 1;
+                state->negotiated = true;
+            }
+
+            if (block != (uint16_t)(state->block + 1)) {
+                // A block of the window was lost. Acknowledge the last block
+                // received in order so the server resends from there, once
+                // per gap rather than for every subsequent block.
+                if (!state->gap_acked) {
+                    state->gap_acked = true;
+                    state->stats->retransmits++;
+                    ret = uboot_tftp_send_ack(state);
+                    if (ret < 0)
+                        return ret;
+                }
+                break;
+            }
+
+            ret = uboot_tftp_deliver(state, &tftp_rx[4], length - 4);
+            if (ret < 0)
+                return ret;
+
+            state->block = block;
+            state->unacked++;
+            state->gap_acked = false;
+            state->stats->blocks++;
+
+            // A short block ends the transfer.
+            if (length - 4 < state->blksize)
+                return uboot_tftp_send_ack(state);
+
+            if (state->unacked >= state->windowsize) {
+                ret = uboot_tftp_send_ack(state);
+                if (ret < 0)
+                    return ret;
+            }
+            break;
+
+        case TFTP_ERROR:
+            tftp_rx[length - 1] = 0;
+            UBOOT_LOGE("TFTP error %u: %s", block, (char *) &tftp_rx[4]);
+            return -EREMOTEIO;
+
+        default:
+            break;
+        }
+
+        retries = 0;
+        start = get_timer(0);
+    }
+}
+
+long uboot_tftp_get(const struct uboot_tftp_request *request, struct uboot_tftp_stats *stats)
+{
+    struct uboot_tftp_stats local_stats;
+    struct uboot_tftp_state_t state;
+
+    if (request == NULL || request->filename == NULL ||
+        (request->buffer == NULL && request->callback == NULL))
+        return -EINVAL;
+
+    if (stats == NULL)
+        stats = &local_stats;
+    memset(stats, 0, sizeof(*stats));
+
+    memset(&state, 0, sizeof(state));
+    state.request = request;
+    state.stats = stats;
+    state.blksize = request->blksize ? request->blksize : UBOOT_TFTP_BLKSIZE;
+    state.windowsize = request->windowsize ? request->windowsize : UBOOT_TFTP_WINDOWSIZE;
+
+    if (state.blksize < 8 || state.blksize > UBOOT_TFTP_MAX_BLKSIZE)
+        return -EINVAL;
+
+    // Use a fresh local port per transfer so that stray packets from an
+    // earlier transfer are not mistaken for this one.
+    state.socket = uboot_udp_bind(local_port);
+    local_port = (local_port == 0xffff) ? UBOOT_TFTP_LOCAL_PORT : local_port + 1;
+    if (state.socket < 0)
+        return state.socket;
+
+    ulong start_us = timer_get_us();
+    int ret = uboot_tftp_transfer(&state);
+
+    stats->bytes = state.offset;
+    stats->blksize = state.blksize;
+    stats->windowsize = state.windowsize;
+    stats->elapsed_us = timer_get_us() - start_us;
+
+    uboot_udp_close(state.socket);
+
+    return (ret < 0) ? ret : (long) state.offset;
+}
+
+#else
+
+long uboot_tftp_get(const struct uboot_tftp_request *request,
+    struct uboot_tftp_stats *stats) { return -ENOSYS; }
+
+#endif
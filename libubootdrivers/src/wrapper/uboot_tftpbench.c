@@ -0,0 +1,514 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This file measures the throughput of the TFTP client against a server
+ * stand-in. A loopback ethernet device takes the place of the network: each
+ * frame sent by the client is consumed by the device, which queues the
+ * server's response to be returned by the next receive. Transfers therefore
+ * run without a network or server, and exercise the same UDP, neighbour and
+ * ethernet routines as a real transfer, less the driver itself.
+ *
+ * The server answers ARP for any address, accepts a read request for any
+ * file, acknowledging the block and window sizes requested, and serves a
+ * file of the configured size. Data blocks may be dropped at a fixed
+ * interval to measure recovery from loss.
+ */
+
+#include <uboot_helper.h>
+#include <net.h>
+#include <env.h>
+#include <dm/device.h>
+#include <dm/device-internal.h>
+#include <dm/root.h>
+#include <asm/global_data.h>
+#include <utils/checksum.h>
+#include <uboot_neigh.h>
+#include "../../include/public_api/uboot_drivers.h"
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#ifdef CONFIG_DM_ETH
+
+#define TFTP_PORT               69
+
+#define TFTP_RRQ                1
+#define TFTP_DATA               3
+#define TFTP_ACK                4
+#define TFTP_ERROR              5
+#define TFTP_OACK               6
+
+/* Port from which the server stand-in runs the transfer */
+#define UBOOT_TFTPBENCH_PORT    50000
+
+#define UBOOT_TFTPBENCH_TTL     64
+
+/* Addresses of the loopback device, and of the server behind it */
+static const u8 loopback_ethaddr[ARP_HLEN] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+static const u8 server_ethaddr[ARP_HLEN] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 };
+
+struct uboot_tftpbench_server_t {
+    const struct uboot_tftp_bench_config *config;
+    /* The client, learnt from its request */
+    u8 client_ethaddr[ARP_HLEN];
+    struct in_addr client_ip;
+    uint16_t client_port;
+    struct in_addr server_ip;
+    /* ARP reply awaiting collection, and the address it resolves */
+    bool arp_pending;
+    struct in_addr arp_ip;
+    /* Option acknowledgement awaiting collection, and the options it holds */
+    bool oack_pending;
+    bool oack_blksize;
+    bool oack_windowsize;
+    bool oack_tsize;
+    unsigned int blksize;
+    unsigned int windowsize;
+    /* Final block of the file, the last block acknowledged, and the blocks
+     * of the current window still to be sent */
+    unsigned long last_block;
+    unsigned long acked;
+    unsigned long next_block;
+    unsigned long window_end;
+    /* Data blocks sent, including those dropped */
+    unsigned long data_sent;
+    unsigned long dropped;
+};
+
+static struct uboot_tftpbench_server_t server;
+
+/* Frame returned by the loopback device */
+static uchar loopback_frame[PKTSIZE_ALIGN] __aligned(ARCH_DMA_MINALIGN);
+
+
+static int uboot_tftpbench_arp_reply(void)
+{
+    struct ethernet_hdr *et = (struct ethernet_hdr *) loopback_frame;
+    struct arp_hdr *arp = (struct arp_hdr *)(loopback_frame + ETHER_HDR_SIZE);
+
+    memcpy(et->et_dest, server.client_ethaddr, ARP_HLEN);
+    memcpy(et->et_src, server_ethaddr, ARP_HLEN);
+    et->et_protlen = htons(PROT_ARP);
+
+    arp->ar_hrd = htons(ARP_ETHER);
+    arp->ar_pro = htons(PROT_IP);
+    arp->ar_hln = ARP_HLEN;
+    arp->ar_pln = ARP_PLEN;
+    arp->ar_op = htons(ARPOP_REPLY);
+    memcpy(&arp->ar_sha, server_ethaddr, ARP_HLEN);
+    net_write_ip(&arp->ar_spa, server.arp_ip);
+    memcpy(&arp->ar_tha, server.client_ethaddr, ARP_HLEN);
+    net_write_ip(&arp->ar_tpa, server.client_ip);
+
+    return ETHER_HDR_SIZE + ARP_HDR_SIZE;
+}
+
+/* Complete the headers of a datagram to the client, whose payload of
+ * 'length' bytes has already been written to the frame */
+static int uboot_tftpbench_udp(int length)
+{
+    struct ethernet_hdr *et = (struct ethernet_hdr *) loopback_frame;
+    struct ip_udp_hdr *ip = (struct ip_udp_hdr *)(loopback_frame + ETHER_HDR_SIZE);
+    int udp_length = 8 + length;
+
+    memcpy(et->et_dest, server.client_ethaddr, ARP_HLEN);
+    memcpy(et->et_src, server_ethaddr, ARP_HLEN);
+    et->et_protlen = htons(PROT_IP);
+
+    ip->ip_hl_v = 0x45;
+    ip->ip_tos = 0;
+    ip->ip_len = htons(IP_HDR_SIZE + udp_length);
+    ip->ip_id = htons(server.data_sent);
+    ip->ip_off = htons(IP_FLAGS_DFRAG);
+    ip->ip_ttl = UBOOT_TFTPBENCH_TTL;
+    ip->ip_p = IPPROTO_UDP;
+    ip->ip_sum = 0;
+    net_write_ip(&ip->ip_src, server.server_ip);
+    net_write_ip(&ip->ip_dst, server.client_ip);
+    ip->ip_sum = inet_checksum(ip, IP_HDR_SIZE);
+
+    ip->udp_src = htons(UBOOT_TFTPBENCH_PORT);
+    ip->udp_dst = htons(server.client_port);
+    ip->udp_len = htons(udp_length);
+    ip->udp_xsum = 0;
+
+    // Checksum as a real server would, so the client verifies every block.
+    uint32_t sum = inet_csum_partial(&ip->ip_src, 2 * sizeof(struct in_addr), 0);
+    sum += htons(IPPROTO_UDP) + htons(udp_length);
+    uint16_t xsum = inet_csum_fold(inet_csum_partial(&ip->udp_src, udp_length, sum));
+    ip->udp_xsum = (xsum == 0) ? 0xffff : xsum;
+
+    return ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + length;
+}
+
+static int uboot_tftpbench_put_option(uchar *p, const char *name, unsigned long value)
+{
+    return sprintf((char *) p, "%s%c%lu", name, 0, value) + 1;
+}
+
+static int uboot_tftpbench_oack(void)
+{
+    uchar *p = loopback_frame + ETHER_HDR_SIZE + IP_UDP_HDR_SIZE;
+    int length = 2;
+
+    p[0] = 0;
+    p[1] = TFTP_OACK;
+
+    // Only the options requested are acknowledged.
+    if (server.oack_blksize)
+        length += uboot_tftpbench_put_option(&p[length], "blksize", server.blksize);
+    if (server.oack_windowsize)
+        length += uboot_tftpbench_put_option(&p[length], "windowsize", server.windowsize);
+    if (server.oack_tsize)
+        length += uboot_tftpbench_put_option(&p[length], "tsize", server.config->file_size);
+
+    return uboot_tftpbench_udp(length);
+}
+
+static int uboot_tftpbench_data(unsigned long block)
+{
+    uchar *p = loopback_frame + ETHER_HDR_SIZE + IP_UDP_HDR_SIZE;
+    unsigned long offset = (block - 1) * server.blksize;
+    int length = min((unsigned long) server.blksize, server.config->file_size - offset);
+
+    p[0] = 0;
+    p[1] = TFTP_DATA;
+    p[2] = (block >> 8) & 0xff;
+    p[3] = block & 0xff;
+    memset(&p[4], block & 0xff, length);
+
+    return uboot_tftpbench_udp(4 + length);
+}
+
+static void uboot_tftpbench_request(struct ip_udp_hdr *ip, uchar *p, int length)
+{
+    uchar *end = p + length;
+
+    server.blksize = 512;
+    server.windowsize = 1;
+    server.oack_blksize = false;
+    server.oack_windowsize = false;
+    server.oack_tsize = false;
+
+    // Skip the opcode, then read the pairs of strings which follow: the file
+    // name and mode, then each option and its value.
+    p += 2;
+    for (int field = 0; p < end; field++) {
+        uchar *name = p;
+        uchar *value = memchr(name, 0, end - name);
+        if (value == NULL || ++value >= end)
+            break;
+        uchar *next = memchr(value, 0, end - value);
+        if (next == NULL)
+            break;
+
+        unsigned long v = simple_strtoul((char *) value, NULL, 10);
+
+        if (field == 0) {
+            // The file is generated whatever its name, in any mode.
+        } else if (strcasecmp((char *) name, "blksize") == 0 && v >= 8) {
+            server.blksize = min(v, (unsigned long)(PKTSIZE - ETHER_HDR_SIZE -
+                IP_UDP_HDR_SIZE - 4));
+            server.oack_blksize = true;
+        } else if (strcasecmp((char *) name, "windowsize") == 0 && v >= 1) {
+            server.windowsize = min(v, 65535ul);
+            server.oack_windowsize = true;
+        } else if (strcasecmp((char *) name, "tsize") == 0) {
+            server.oack_tsize = true;
+        }
+
+        p = next + 1;
+    }
+
+    server.client_ip = net_read_ip(&ip->ip_src);
+    server.client_port = ntohs(ip->udp_src);
+    server.server_ip = net_read_ip(&ip->ip_dst);
+    server.last_block = server.config->file_size / server.blksize + 1;
+    server.acked = 0;
+    server.next_block = 0;
+    server.window_end = 0;
+
+    // A server acknowledging options waits for the client to acknowledge in
+    // turn (block 0); otherwise it sends the first block at once.
+    if (server.oack_blksize || server.oack_windowsize || server.oack_tsize) {
+        server.oack_pending = true;
+    } else {
+        server.next_block = 1;
+        server.window_end = 2;
+    }
+}
+
+static void uboot_tftpbench_ack(uint16_t block)
+{
+    // Acknowledgements carry the low 16 bits of the block number. Ignore any
+    // beyond the window last sent.
+    uint16_t advance = block - (uint16_t) server.acked;
+    if (advance > server.windowsize)
+        return;
+
+    server.acked += advance;
+    if (server.acked >= server.last_block) {
+        server.next_block = server.window_end = 0;
+        return;
+    }
+
+    // Send the next window, or resend from the block following a repeated
+    // acknowledgement.
+    server.next_block = server.acked + 1;
+    server.window_end = min(server.acked + server.windowsize, server.last_block) + 1;
+}
+
+static int uboot_tftpbench_send(struct udevice *dev, void *packet, int length)
+{
+    struct ethernet_hdr *et = (struct ethernet_hdr *) packet;
+
+    if (length < ETHER_HDR_SIZE)
+        return 0;
+
+    if (ntohs(et->et_protlen) == PROT_ARP) {
+        struct arp_hdr *arp = (struct arp_hdr *)((uchar *) packet + ETHER_HDR_SIZE);
+
+        if (length < ETHER_HDR_SIZE + ARP_HDR_SIZE || ntohs(arp->ar_op) != ARPOP_REQUEST)
+            return 0;
+
+        // Answer for any address except that of the client itself, so that
+        // a gratuitous request goes unanswered.
+        struct in_addr sender = net_read_ip(&arp->ar_spa);
+        struct in_addr target = net_read_ip(&arp->ar_tpa);
+        if (sender.s_addr == target.s_addr)
+            return 0;
+
+        memcpy(server.client_ethaddr, &arp->ar_sha, ARP_HLEN);
+        server.client_ip = sender;
+        server.arp_ip = target;
+        server.arp_pending = true;
+        return 0;
+    }
+
+    struct ip_udp_hdr *ip = (struct ip_udp_hdr *)((uchar *) packet + ETHER_HDR_SIZE);
+    uchar *p = (uchar *) packet + ETHER_HDR_SIZE + IP_UDP_HDR_SIZE;
+
+    if (ntohs(et->et_protlen) != PROT_IP || length < ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + 4 ||
+        ip->ip_p != IPPROTO_UDP)
+        return 0;
+
+    int payload = min(length, (int)(ETHER_HDR_SIZE + IP_HDR_SIZE) + ntohs(ip->udp_len)) -
+        (int)(ETHER_HDR_SIZE + IP_UDP_HDR_SIZE);
+    uint16_t opcode = (p[0] << 8) | p[1];
+    uint16_t port = ntohs(ip->udp_dst);
+
+    memcpy(server.client_ethaddr, et->et_src, ARP_HLEN);
+
+    if (port == TFTP_PORT && opcode == TFTP_RRQ) {
+        uboot_tftpbench_request(ip, p, payload);
+    } else if (port == UBOOT_TFTPBENCH_PORT && opcode == TFTP_ACK) {
+        uboot_tftpbench_ack((p[2] << 8) | p[3]);
+    } else if (port == UBOOT_TFTPBENCH_PORT && opcode == TFTP_ERROR) {
+        server.oack_pending = false;
+        server.next_block = server.window_end = 0;
+    }
+
+    return 0;
+}
+
+static int uboot_tftpbench_recv(struct udevice *dev, int flags, uchar **packetp)
+{
+    *packetp = loopback_frame;
+
+    if (server.arp_pending) {
+        server.arp_pending = false;
+        return uboot_tftpbench_arp_reply();
+    }
+
+    if (server.oack_pending) {
+        server.oack_pending = false;
+        return uboot_tftpbench_oack();
+    }
+
+    while (server.next_block < server.window_end) {
+        unsigned long block = server.next_block++;
+
+        // Drop every 'loss_interval'th block sent.
+        server.data_sent++;
+        if (server.config->loss_interval != 0 &&
+            server.data_sent % server.config->loss_interval == 0) {
+            server.dropped++;
+            continue;
+        }
+
+        return uboot_tftpbench_data(block);
+    }
+
+    return -EAGAIN;
+}
+
+static int uboot_tftpbench_start(struct udevice *dev)
+{
+    return 0;
+}
+
+static void uboot_tftpbench_stop(struct udevice *dev)
+{
+}
+
+static int uboot_tftpbench_free_pkt(struct udevice *dev, uchar *packet, int length)
+{
+    return 0;
+}
+
+static int uboot_tftpbench_read_rom_hwaddr(struct udevice *dev)
+{
+    struct eth_pdata *pdata = dev_get_plat(dev);
+
+    memcpy(pdata->enetaddr, loopback_ethaddr, ARP_HLEN);
+
+    return 0;
+}
+
+static const struct eth_ops uboot_tftpbench_ops = {
+    .start = uboot_tftpbench_start,
+    .send = uboot_tftpbench_send,
+    .recv = uboot_tftpbench_recv,
+    .free_pkt = uboot_tftpbench_free_pkt,
+    .stop = uboot_tftpbench_stop,
+    .read_rom_hwaddr = uboot_tftpbench_read_rom_hwaddr,
+};
+
+U_BOOT_DRIVER(uboot_tftp_loopback_eth) = {
+    .name = "uboot_tftp_loopback_eth",
+    .id = UCLASS_ETH,
+    .ops = &uboot_tftpbench_ops,
+    .plat_auto = sizeof(struct eth_pdata),
+};
+
+static int uboot_tftpbench_discard(void *cookie, const void *data, unsigned long offset,
+    int length)
+{
+    return 0;
+}
+
+/* Make 'dev' the current ethernet device, or restore the default if NULL */
+static void uboot_tftpbench_set_dev(struct udevice *dev)
+{
+    env_set("ethact", (dev != NULL) ? dev->name : NULL);
+    eth_set_current();
+}
+
+/* Choose an address for the server on the client's subnet, other than the
+ * client's own and the subnet's network and broadcast addresses */
+static int uboot_tftpbench_server_ip(struct in_addr ipaddr, uint32_t *server_ip)
+{
+    uint32_t ip = ntohl(ipaddr.s_addr);
+    uint32_t host_mask = ~ntohl(env_get_ip("netmask").s_addr);
+
+    for (uint32_t flip = 1; flip <= 3; flip++) {
+        uint32_t candidate = ip ^ flip;
+        uint32_t host = candidate & host_mask;
+
+        if ((candidate & ~host_mask) != (ip & ~host_mask))
+            continue;
+
+        // A /31 subnet has neither network nor broadcast address.
+        if (host_mask != 1 && (host == 0 || host == host_mask))
+            continue;
+
+        *server_ip = candidate;
+        return 0;
+    }
+
+    return -EADDRNOTAVAIL;
+}
+
+int uboot_tftp_bench_run(const struct uboot_tftp_bench_config *config,
+    struct uboot_tftp_bench_result *result)
+{
+    struct udevice *dev;
+    uint32_t server_ip;
+    int ret;
+
+    // Return immediately if library not initialised.
+    if (gd == NULL || gd->dm_root == NULL)
+        return -ENODEV;
+
+    if (config == NULL || result == NULL || config->file_size == 0)
+        return -EINVAL;
+
+    memset(result, 0, sizeof(*result));
+
+    struct in_addr ipaddr = env_get_ip("ipaddr");
+    if (ipaddr.s_addr == 0) {
+        UBOOT_LOGE("No IP address set in environment variable 'ipaddr'");
+        return -EADDRNOTAVAIL;
+    }
+
+    if (uboot_tftpbench_server_ip(ipaddr, &server_ip) != 0) {
+        UBOOT_LOGE("No address for the server on the subnet of 'ipaddr'");
+        return -EADDRNOTAVAIL;
+    }
+
+    // The loopback device stands in for the current device, which is halted
+    // first so that its rings are no longer used.
+    struct udevice *previous = eth_get_dev();
+    uboot_eth_halt();
+
+    ret = device_bind_driver(dm_root(), "uboot_tftp_loopback_eth", "tftp-loopback", &dev);
+    if (ret < 0)
+        return ret;
+
+    ret = device_probe(dev);
+    if (ret < 0) {
+        device_unbind(dev);
+        return ret;
+    }
+
+    uboot_tftpbench_set_dev(dev);
+
+    ret = eth_init();
+    if (ret == 0) {
+        memset(&server, 0, sizeof(server));
+        server.config = config;
+
+        // The server is placed on the same subnet as the client.
+        struct uboot_tftp_request request = {
+            .server_ip = server_ip,
+            .filename = "loopback",
+            .blksize = config->blksize,
+            .windowsize = config->windowsize,
+            .callback = uboot_tftpbench_discard,
+        };
+
+        long size = uboot_tftp_get(&request, &result->stats);
+        if (size < 0)
+            ret = size;
+        else if (size != config->file_size)
+            ret = -EIO;
+
+        eth_halt();
+    }
+
+    uboot_tftpbench_set_dev(previous);
+    device_remove(dev, DM_REMOVE_NORMAL);
+    device_unbind(dev);
+
+    // The server's address was resolved to the loopback device, which the
+    // network must not be sent to.
+    uboot_neigh_forget((struct in_addr) { .s_addr = htonl(server_ip) });
+
+    if (ret < 0)
+        return ret;
+
+    result->dropped = server.dropped;
+    if (result->stats.elapsed_us > 0)
+        result->kib_per_s = (result->stats.bytes * 1000000ull / 1024) /
+            result->stats.elapsed_us;
+
+    return 0;
+}
+
+#else
+
+int uboot_tftp_bench_run(const struct uboot_tftp_bench_config *config,
+    struct uboot_tftp_bench_result *result) { return -ENOSYS; }
+
+#endif
@@ -0,0 +1,433 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This file provides a minimal UDP datagram interface directly over the
+ * ethernet routines of the wrapper, independent of U-Boot's NetLoop. Socket
+ * state persists between calls and addresses are resolved through the
+ * shared neighbour cache, so traffic can flow continuously rather than
+ * through single-shot U-Boot commands.
+ *
+ * The payload of each received datagram is copied into a buffer shared by
+ * all sockets until collected by uboot_udp_recvfrom, and the frame returned
+ * to the ethernet layer at once; holding loaned frames instead would stall
+ * reception once the spare receive buffers ran out. Frames other than ARP
+ * and UDP for a bound port are discarded, so this interface should not be
+ * mixed with other consumers of uboot_eth_receive.
+ */
+
+#include <uboot_helper.h>
+#include <net.h>
+#include <env.h>
+#include <uboot_eth.h>
+#include <uboot_neigh.h>
+#include <uboot_udp.h>
+#include <utils/checksum.h>
+
+#ifdef CONFIG_DM_ETH
+
+/* Maximum number of bound sockets */
+#define UBOOT_UDP_MAX_SOCKETS   8
+
+/* Maximum number of datagrams held for each socket */
+#define UBOOT_UDP_QUEUE_LEN     16
+
+/* Number of buffers holding received datagrams across all sockets, and the
+ * largest payload each can hold */
+#define UBOOT_UDP_RX_BUFFERS    32
+#define UBOOT_UDP_MAX_PAYLOAD   (PKTSIZE - ETHER_HDR_SIZE - IP_UDP_HDR_SIZE)
+
+/* Number of ARP requests sent before a resolution fails */
+#define UBOOT_UDP_ARP_RETRIES   3
+
+/* Maximum number of frames collected per poll of the ethernet device */
+#define UBOOT_UDP_POLL_BURST    16
+
+#define UBOOT_UDP_TTL           64
+
+struct uboot_udp_datagram_t {
+    int buffer;
+    int length;
+    uint32_t ip;
+    uint16_t port;
+};
+
+struct uboot_udp_socket_t {
+    bool bound;
+    uint16_t port;
+    unsigned int head;
+    unsigned int count;
+    struct uboot_udp_datagram_t queue[UBOOT_UDP_QUEUE_LEN];
+};
+
+static struct uboot_udp_socket_t sockets[UBOOT_UDP_MAX_SOCKETS];
+
+/* Payloads of datagrams awaiting collection */
+static uchar udp_rx_data[UBOOT_UDP_RX_BUFFERS][UBOOT_UDP_MAX_PAYLOAD];
+static bool udp_rx_used[UBOOT_UDP_RX_BUFFERS];
+
+/* Local address configuration, read from the environment on first bind */
+static struct in_addr udp_ip;
+static struct in_addr udp_netmask;
+static struct in_addr udp_gateway;
+
+static u16 udp_ip_id;
+
+/* Frame under construction for transmission */
+static uchar udp_tx_frame[PKTSIZE_ALIGN] __aligned(ARCH_DMA_MINALIGN);
+
+
+static int uboot_udp_send_arp(int op, const u8 *target_ethaddr, struct in_addr target_ip)
+{
+    struct ethernet_hdr *et = (struct ethernet_hdr *) udp_tx_frame;
+    struct arp_hdr *arp = (struct arp_hdr *)(udp_tx_frame + ETHER_HDR_SIZE);
+    const u8 *ethaddr = uboot_eth_get_ethaddr();
+
+    memcpy(et->et_dest, (op == ARPOP_REQUEST) ? net_bcast_ethaddr : target_ethaddr, ARP_HLEN);
+    memcpy(et->et_src, ethaddr, ARP_HLEN);
+    et->et_protlen = htons(PROT_ARP);
+
+    arp->ar_hrd = htons(ARP_ETHER);
+    arp->ar_pro = htons(PROT_IP);
+    arp->ar_hln = ARP_HLEN;
+    arp->ar_pln = ARP_PLEN;
+    arp->ar_op = htons(op);
+    memcpy(&arp->ar_sha, ethaddr, ARP_HLEN);
+    net_write_ip(&arp->ar_spa, udp_ip);
+    if (op == ARPOP_REQUEST)
+        memset(&arp->ar_tha, 0, ARP_HLEN);
+    else
+        memcpy(&arp->ar_tha, target_ethaddr, ARP_HLEN);
+    net_write_ip(&arp->ar_tpa, target_ip);
+
+    return uboot_eth_send(udp_tx_frame, ETHER_HDR_SIZE + ARP_HDR_SIZE);
+}
+
+static void uboot_udp_receive_arp(unsigned char *packet, int length)
+{
+    struct arp_hdr *arp = (struct arp_hdr *)(packet + ETHER_HDR_SIZE);
+
+    if (length < ETHER_HDR_SIZE + ARP_HDR_SIZE ||
+        ntohs(arp->ar_hrd) != ARP_ETHER || ntohs(arp->ar_pro) != PROT_IP ||
+        arp->ar_hln != ARP_HLEN || arp->ar_pln != ARP_PLEN)
+        return;
+
+    // Replies and announcements need only be learnt.
+    if (uboot_neigh_announce((struct ethernet_hdr *) packet, arp))
+        return;
+
+    struct in_addr sender_ip = net_read_ip(&arp->ar_spa);
+    struct in_addr target_ip = net_read_ip(&arp->ar_tpa);
+
+    if (target_ip.s_addr != udp_ip.s_addr)
+        return;
+
+    // Learn the sender of any request addressed to us.
+    uboot_neigh_update(sender_ip, &arp->ar_sha);
+
+    if (ntohs(arp->ar_op) == ARPOP_REQUEST)
+        uboot_udp_send_arp(ARPOP_REPLY, &arp->ar_sha, sender_ip);
+}
+
+static int uboot_udp_rx_alloc(void)
+{
+    for (int i = 0; i < UBOOT_UDP_RX_BUFFERS; i++) {
+        if (!udp_rx_used[i]) {
+            udp_rx_used[i] = true;
+            return i;
+        }
+    }
+
+    return -ENOMEM;
+}
+
+static void uboot_udp_dequeue(struct uboot_udp_socket_t *sock)
+{
+    udp_rx_used[sock->queue[sock->head].buffer] = false;
+    sock->head = (sock->head + 1) % UBOOT_UDP_QUEUE_LEN;
+    sock->count--;
+}
+
+static uint32_t uboot_udp_checksum(struct ip_udp_hdr *ip, int udp_length)
+{
+    // Sum the pseudo header (addresses, protocol and length) then the UDP
+    // header and payload.
+    uint32_t sum = inet_csum_partial(&ip->ip_src, 2 * sizeof(struct in_addr), 0);
+    sum += htons(IPPROTO_UDP) + htons(udp_length);
+
+    return inet_csum_partial(&ip->udp_src, udp_length, sum);
+}
+
+static void uboot_udp_receive_ip(unsigned char *packet, int length)
+{
+    struct ip_udp_hdr *ip = (struct ip_udp_hdr *)(packet + ETHER_HDR_SIZE);
+
+    if (length < ETHER_HDR_SIZE + IP_UDP_HDR_SIZE)
+        return;
+
+    // Only unfragmented UDP datagrams without IP options are accepted.
+    if (ip->ip_hl_v != 0x45 || ip->ip_p != IPPROTO_UDP ||
+        (ntohs(ip->ip_off) & (IP_OFFS | IP_FLAGS_MFRAG)) != 0)
+        return;
+
+    struct in_addr dst = net_read_ip(&ip->ip_dst);
+    if (dst.s_addr != udp_ip.s_addr && dst.s_addr != 0xffffffff)
+        return;
+
+    int ip_length = ntohs(ip->ip_len);
+    int udp_length = ntohs(ip->udp_len);
+    if (ip_length > length - ETHER_HDR_SIZE || udp_length < 8 ||
+        udp_length > ip_length - IP_HDR_SIZE)
+        return;
+
+    if (inet_checksum(ip, IP_HDR_SIZE) != 0)
+        return;
+
+    // A zero checksum indicates that none was generated by the sender.
+    if (ip->udp_xsum != 0 && inet_csum_fold(uboot_udp_checksum(ip, udp_length)) != 0)
+        return;
+
+    uint16_t port = ntohs(ip->udp_dst);
+    for (int i = 0; i < UBOOT_UDP_MAX_SOCKETS; i++) {
+        struct uboot_udp_socket_t *sock = &sockets[i];
+
+        if (!sock->bound || sock->port != port)
+            continue;
+
+        if (udp_length - 8 > UBOOT_UDP_MAX_PAYLOAD)
+            return;
+
+        // Drop the datagram if the socket is not being read, or if the
+        // datagrams held for all sockets have used every buffer.
+        if (sock->count == UBOOT_UDP_QUEUE_LEN)
+            return;
+
+        int buffer = uboot_udp_rx_alloc();
+        if (buffer < 0)
+            return;
+
+        struct uboot_udp_datagram_t *dgram =
+            &sock->queue[(sock->head + sock->count) % UBOOT_UDP_QUEUE_LEN];
+        dgram->buffer = buffer;
+        dgram->length = udp_length - 8;
+        dgram->ip = ntohl(net_read_ip(&ip->ip_src).s_addr);
+        dgram->port = ntohs(ip->udp_src);
+        memcpy(udp_rx_data[buffer], packet + ETHER_HDR_SIZE + IP_UDP_HDR_SIZE,
+            dgram->length);
+        sock->count++;
+
+        return;
+    }
+}
+
+static int uboot_udp_poll(void)
+{
+    unsigned char *packets[UBOOT_UDP_POLL_BURST];
+    int lengths[UBOOT_UDP_POLL_BURST];
+
+    int count = uboot_eth_receive_burst(packets, lengths, UBOOT_UDP_POLL_BURST);
+    if (count <= 0)
+        return count;
+
+    for (int i = 0; i < count; i++) {
+        struct ethernet_hdr *et = (struct ethernet_hdr *) packets[i];
+
+        switch (ntohs(et->et_protlen)) {
+        case PROT_ARP:
+            uboot_udp_receive_arp(packets[i], lengths[i]);
+            break;
+        case PROT_IP:
+            uboot_udp_receive_ip(packets[i], lengths[i]);
+            break;
+        default:
+            break;
+        }
+
+        uboot_eth_free_packet(&packets[i]);
+    }
+
+    return count;
+}
+
+static int uboot_udp_resolve(struct in_addr ip, u8 *ethaddr)
+{
+    // Broadcasts need no resolution.
+    if (ip.s_addr == 0xffffffff) {
+        memcpy(ethaddr, net_bcast_ethaddr, ARP_HLEN);
+        return 0;
+    }
+
+    // Off-subnet destinations are reached through the gateway.
+    struct in_addr next_hop = ip;
+    if ((ip.s_addr & udp_netmask.s_addr) != (udp_ip.s_addr & udp_netmask.s_addr)) {
+        if (udp_gateway.s_addr == 0)
+            return -EHOSTUNREACH;
+        next_hop = udp_gateway;
+    }
+
+    for (int attempt = 0; attempt < UBOOT_UDP_ARP_RETRIES; attempt++) {
+        if (uboot_neigh_lookup(next_hop, ethaddr))
+            return 0;
+
+        int ret = uboot_udp_send_arp(ARPOP_REQUEST, NULL, next_hop);
+        if (ret < 0)
+            return ret;
+
+        ulong start = get_timer(0);
+        while (get_timer(start) < CONFIG_ARP_TIMEOUT) {
+            uboot_udp_poll();
+
+            if (uboot_neigh_lookup(next_hop, ethaddr))
+                return 0;
+        }
+    }
+
+    UBOOT_LOGW("Failed to resolve %pI4", &next_hop);
+    return -ETIMEDOUT;
+}
+
+int uboot_udp_bind(uint16_t port)
+{
+    int free_socket = -1;
+
+    if (port == 0)
+        return -EINVAL;
+
+    // The local address is read once, on the first bind.
+    if (udp_ip.s_addr == 0) {
+        udp_ip = env_get_ip("ipaddr");
+        udp_netmask = env_get_ip("netmask");
+        udp_gateway = env_get_ip("gatewayip");
+        if (udp_ip.s_addr == 0) {
+            UBOOT_LOGE("No IP address set in environment variable 'ipaddr'");
+            return -EADDRNOTAVAIL;
+        }
+    }
+
+    for (int i = 0; i < UBOOT_UDP_MAX_SOCKETS; i++) {
+        if (sockets[i].bound && sockets[i].port == port)
+            return -EADDRINUSE;
+        if (!sockets[i].bound && free_socket < 0)
+            free_socket = i;
+    }
+
+    if (free_socket < 0)
+        return -ENOMEM;
+
+    sockets[free_socket].bound = true;
+    sockets[free_socket].port = port;
+    sockets[free_socket].head = 0;
+    sockets[free_socket].count = 0;
+
+    return free_socket;
+}
+
+int uboot_udp_close(int socket)
+{
+    if (socket < 0 || socket >= UBOOT_UDP_MAX_SOCKETS || !sockets[socket].bound)
+        return -EINVAL;
+
+    struct uboot_udp_socket_t *sock = &sockets[socket];
+
+    // Discard any uncollected datagrams.
+    while (sock->count > 0)
+        uboot_udp_dequeue(sock);
+
+    sock->bound = false;
+
+    return 0;
+}
+
+int uboot_udp_sendto(int socket, const void *data, int length, uint32_t ip,
+    uint16_t port)
+{
+    if (socket < 0 || socket >= UBOOT_UDP_MAX_SOCKETS || !sockets[socket].bound)
+        return -EINVAL;
+
+    if (length < 0 || length > PKTSIZE - ETHER_HDR_SIZE - IP_UDP_HDR_SIZE)
+        return -EMSGSIZE;
+
+    struct in_addr dst = { .s_addr = htonl(ip) };
+    u8 ethaddr[ARP_HLEN];
+
+    int ret = uboot_udp_resolve(dst, ethaddr);
+    if (ret < 0)
+        return ret;
+
+    struct ethernet_hdr *et = (struct ethernet_hdr *) udp_tx_frame;
+    struct ip_udp_hdr *iph = (struct ip_udp_hdr *)(udp_tx_frame + ETHER_HDR_SIZE);
+
+    memcpy(et->et_dest, ethaddr, ARP_HLEN);
+    memcpy(et->et_src, uboot_eth_get_ethaddr(), ARP_HLEN);
+    et->et_protlen = htons(PROT_IP);
+
+    iph->ip_hl_v = 0x45;
+    iph->ip_tos = 0;
+    iph->ip_len = htons(IP_UDP_HDR_SIZE + length);
+    iph->ip_id = htons(udp_ip_id++);
+    iph->ip_off = htons(IP_FLAGS_DFRAG);
+    iph->ip_ttl = UBOOT_UDP_TTL;
+    iph->ip_p = IPPROTO_UDP;
+    iph->ip_sum = 0;
+    net_write_ip(&iph->ip_src, udp_ip);
+    net_write_ip(&iph->ip_dst, dst);
+    iph->ip_sum = inet_checksum(iph, IP_HDR_SIZE);
+
+    iph->udp_src = htons(sockets[socket].port);
+    iph->udp_dst = htons(port);
+    iph->udp_len = htons(8 + length);
+    iph->udp_xsum = 0;
+
+    memcpy(udp_tx_frame + ETHER_HDR_SIZE + IP_UDP_HDR_SIZE, data, length);
+
+    // A calculated checksum of zero is sent as all ones, zero meaning that
+    // no checksum is present.
+    uint16_t xsum = inet_csum_fold(uboot_udp_checksum(iph, 8 + length));
+    iph->udp_xsum = (xsum == 0) ? 0xffff : xsum;
+
+    ret = uboot_eth_send(udp_tx_frame, ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + length);
+
+    return (ret < 0) ? ret : length;
+}
+
+int uboot_udp_recvfrom(int socket, void *buffer, int length, uint32_t *ip,
+    uint16_t *port)
+{
+    if (socket < 0 || socket >= UBOOT_UDP_MAX_SOCKETS || !sockets[socket].bound)
+        return -EINVAL;
+
+    struct uboot_udp_socket_t *sock = &sockets[socket];
+
+    if (sock->count == 0) {
+        int ret = uboot_udp_poll();
+        if (ret < 0)
+            return ret;
+        if (sock->count == 0)
+            return 0;
+    }
+
+    struct uboot_udp_datagram_t *dgram = &sock->queue[sock->head];
+    int copied = min(length, dgram->length);
+
+    memcpy(buffer, udp_rx_data[dgram->buffer], copied);
+    if (ip != NULL)
+        *ip = dgram->ip;
+    if (port != NULL)
+        *port = dgram->port;
+
+    uboot_udp_dequeue(sock);
+
+    return copied;
+}
+
+#else
+
+int uboot_udp_bind(uint16_t port) { return 0; }
+int uboot_udp_close(int socket) { return 0; }
+int uboot_udp_sendto(int socket, const void *data, int length, uint32_t ip,
+    uint16_t port) { return 0; }
+int uboot_udp_recvfrom(int socket, void *buffer, int length, uint32_t *ip,
+    uint16_t *port) { return 0; }
+
+#endif
@@ -0,0 +1,331 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This file provides large reads from USB mass storage devices using the
+ * Bulk-Only Transport. U-Boot's usb_storage driver limits each command to
+ * 240 blocks (120KB), and as every command costs a command block, a status
+ * block and the wait for each, sequential reads fall well short of the bus
+ * rate.
+ *
+ * The read operation of the driver is wrapped so that large reads are
+ * instead issued here as READ(10) commands of up to the negotiated maximum
+ * transfer size, which starts at 1MB for SuperSpeed devices and 512KB
+ * otherwise, limited by the host controller. Should the transport fail
+ * during such a command, it is reset, the maximum halved and the read
+ * retried, until at the driver's own limit the device is left to the driver.
+ * A command the device itself reports as failed (e.g. a medium error) is
+ * returned as a short read, keeping the transfer size.
+ *
+ * The transport allows only a single command to be outstanding, so commands
+ * cannot be overlapped; the gain is in issuing fewer of them.
+ */
+
+#include <uboot_helper.h>
+#include <blk.h>
+#include <usb.h>
+#include <dm/device.h>
+#include <driver_data.h>
+#include <uboot_usbstor.h>
+#include "../../include/public_api/uboot_drivers.h"
+
+#ifdef CONFIG_USB_STORAGE
+
+/* Blocks per command used by the usb_storage driver, and the largest
+ * transfer of a READ(10) command */
+#define UBOOT_USBSTOR_DRIVER_BLOCKS 240
+#define UBOOT_USBSTOR_MAX_BLOCKS    65535
+
+/* Default maximum transfer (bytes) of SuperSpeed and slower devices */
+#define UBOOT_USBSTOR_SS_XFER       (1024 * 1024)
+#define UBOOT_USBSTOR_HS_XFER       (512 * 1024)
+
+/* Number of devices whose transport is tracked */
+#define UBOOT_USBSTOR_MAX_DEVICES   4
+
+/* Time (ms) allowed for each phase of a command */
+#define UBOOT_USBSTOR_TIMEOUT_MS    5000
+
+#define BOT_CBW_SIGNATURE           0x43425355
+#define BOT_CSW_SIGNATURE           0x53425355
+#define BOT_CBW_LENGTH              31
+#define BOT_CSW_LENGTH              13
+#define BOT_CBW_FLAG_IN             0x80
+#define BOT_RESET_REQUEST           0xff
+#define BOT_CSW_STATUS_FAILED       1
+
+#define SCSI_READ10                 0x28
+
+struct uboot_usbstor_device_t {
+    struct udevice *dev;
+    bool usable;                /* a Bulk-Only interface was found */
+    unsigned long max_blocks;   /* per command, zero to leave to the driver */
+    int ifnum;
+    unsigned int pipe_in;
+    unsigned int pipe_out;
+};
+
+static struct uboot_usbstor_device_t devices[UBOOT_USBSTOR_MAX_DEVICES];
+
+/* Maximum transfer (blocks) set through the public interface, zero for the
+ * default according to the speed of the device */
+static unsigned long configured_blocks;
+
+/* Operations of the wrapped driver, and the wrapper in their place */
+static const struct blk_ops *driver_ops;
+static struct blk_ops interposed_ops;
+
+static uint32_t tag;
+
+/* Command and status blocks */
+static uint8_t cbw[BOT_CBW_LENGTH] __aligned(ARCH_DMA_MINALIGN);
+static uint8_t csw[BOT_CSW_LENGTH] __aligned(ARCH_DMA_MINALIGN);
+
+
+static inline void uboot_usbstor_put_le32(uint8_t *p, uint32_t value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+static inline uint32_t uboot_usbstor_get_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static unsigned long uboot_usbstor_default_blocks(struct usb_device *udev,
+    struct blk_desc *desc)
+{
+    unsigned long bytes = (udev->speed >= USB_SPEED_SUPER) ?
+        UBOOT_USBSTOR_SS_XFER : UBOOT_USBSTOR_HS_XFER;
+    size_t limit;
+
+    if (configured_blocks > 0)
+        bytes = configured_blocks * desc->blksz;
+
+    // The host controller bounds the length of a single transfer.
+    if (usb_get_max_xfer_size(udev, &limit) >= 0 && limit < bytes)
+        bytes = limit;
+
+    return min(bytes / desc->blksz, (unsigned long) UBOOT_USBSTOR_MAX_BLOCKS);
+}
+
+/* Find the Bulk-Only interface and endpoints of the device */
+static void uboot_usbstor_probe(struct uboot_usbstor_device_t *entry, struct usb_device *udev,
+    struct blk_desc *desc)
+{
+    for (int i = 0; i < udev->config.no_of_if; i++) {
+        struct usb_interface *iface = &udev->config.if_desc[i];
+        int in = -1, out = -1;
+
+        if (iface->desc.bInterfaceClass != USB_CLASS_MASS_STORAGE ||
+            iface->desc.bInterfaceProtocol != US_PR_BULK)
+            continue;
+
+        for (int e = 0; e < iface->no_of_ep; e++) {
+            struct usb_endpoint_descriptor *ep = &iface->ep_desc[e];
+
+            if ((ep->bmAttributes & USB_ENDPOINT_XFERTYPE_MASK) != USB_ENDPOINT_XFER_BULK)
+                continue;
+            if (ep->bEndpointAddress & USB_DIR_IN)
+                in = ep->bEndpointAddress & USB_ENDPOINT_NUMBER_MASK;
+            else
+                out = ep->bEndpointAddress & USB_ENDPOINT_NUMBER_MASK;
+        }
+
+        if (in < 0 || out < 0)
+            continue;
+
+        entry->ifnum = iface->desc.bInterfaceNumber;
+        entry->pipe_in = usb_rcvbulkpipe(udev, in);
+        entry->pipe_out = usb_sndbulkpipe(udev, out);
+        entry->max_blocks = uboot_usbstor_default_blocks(udev, desc);
+        entry->usable = true;
+        return;
+    }
+}
+
+static struct uboot_usbstor_device_t *uboot_usbstor_device(struct udevice *dev,
+    struct usb_device *udev, struct blk_desc *desc)
+{
+    struct uboot_usbstor_device_t *entry = NULL;
+
+    for (int i = 0; i < UBOOT_USBSTOR_MAX_DEVICES; i++) {
+        if (devices[i].dev == dev)
+            return &devices[i];
+        if (devices[i].dev == NULL && entry == NULL)
+            entry = &devices[i];
+    }
+
+    if (entry == NULL)
+        return NULL;
+
+    memset(entry, 0, sizeof(*entry));
+    entry->dev = dev;
+    uboot_usbstor_probe(entry, udev, desc);
+
+    return entry;
+}
+
+/* Reset recovery (Bulk-Only Transport 5.3.4), returning the device to a
+ * state in which the driver may continue */
+static void uboot_usbstor_reset(struct uboot_usbstor_device_t *entry, struct usb_device *udev)
+{
+    usb_control_msg(udev, usb_sndctrlpipe(udev, 0), BOT_RESET_REQUEST,
+        USB_TYPE_CLASS | USB_RECIP_INTERFACE, 0, entry->ifnum, NULL, 0,
+        UBOOT_USBSTOR_TIMEOUT_MS);
+    usb_clear_halt(udev, entry->pipe_in);
+    usb_clear_halt(udev, entry->pipe_out);
+}
+
+/* Issue a READ(10) command, returning -EIO if the device reported the
+ * command failed (e.g. a medium error), or -EPROTO if the transport failed
+ * and must be reset */
+static int uboot_usbstor_read10(struct uboot_usbstor_device_t *entry, struct usb_device *udev,
+    struct blk_desc *desc, lbaint_t start, unsigned long blkcnt, void *buffer)
+{
+    unsigned long length = blkcnt * desc->blksz;
+    int actual;
+
+    memset(cbw, 0, sizeof(cbw));
+    uboot_usbstor_put_le32(&cbw[0], BOT_CBW_SIGNATURE);
+    uboot_usbstor_put_le32(&cbw[4], ++tag);
+    uboot_usbstor_put_le32(&cbw[8], length);
+    cbw[12] = BOT_CBW_FLAG_IN;
+    cbw[13] = desc->lun;
+    cbw[14] = 10;
+    cbw[15] = SCSI_READ10;
+    cbw[17] = start >> 24;
+    cbw[18] = start >> 16;
+    cbw[19] = start >> 8;
+    cbw[20] = start;
+    cbw[22] = blkcnt >> 8;
+    cbw[23] = blkcnt;
+
+    if (usb_bulk_msg(udev, entry->pipe_out, cbw, sizeof(cbw), &actual,
+        UBOOT_USBSTOR_TIMEOUT_MS) != 0 || actual != sizeof(cbw))
+        return -EPROTO;
+
+    // A stalled data phase is cleared so that the status may be read.
+    int ret = usb_bulk_msg(udev, entry->pipe_in, buffer, length, &actual,
+        UBOOT_USBSTOR_TIMEOUT_MS);
+    if (ret != 0 && (udev->status & USB_ST_STALLED))
+        usb_clear_halt(udev, entry->pipe_in);
+
+    if (usb_bulk_msg(udev, entry->pipe_in, csw, sizeof(csw), &actual,
+        UBOOT_USBSTOR_TIMEOUT_MS) != 0 || actual != sizeof(csw))
+        return -EPROTO;
+
+    if (uboot_usbstor_get_le32(&csw[0]) != BOT_CSW_SIGNATURE ||
+        uboot_usbstor_get_le32(&csw[4]) != tag)
+        return -EPROTO;
+
+    // A valid status reporting failure leaves the transport in step; the
+    // device may have stalled the data phase in ending it early.
+    if (csw[12] == BOT_CSW_STATUS_FAILED)
+        return -EIO;
+
+    if (csw[12] != 0 || uboot_usbstor_get_le32(&csw[8]) != 0 || ret != 0)
+        return -EPROTO;
+
+    return 0;
+}
+
+static ulong uboot_usbstor_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+    void *buffer)
+{
+    struct blk_desc *desc = dev_get_uclass_plat(dev);
+    struct usb_device *udev = dev_get_parent_priv(dev_get_parent(dev));
+    struct uboot_usbstor_device_t *entry = uboot_usbstor_device(dev, udev, desc);
+
+    // Reads the driver would issue as a single command gain nothing, and
+    // READ(10) addresses only the first 2^32 blocks.
+    if (entry == NULL || !entry->usable || entry->max_blocks <= UBOOT_USBSTOR_DRIVER_BLOCKS ||
+        blkcnt <= UBOOT_USBSTOR_DRIVER_BLOCKS || start + blkcnt > 0xffffffffULL)
+        return driver_ops->read(dev, start, blkcnt, buffer);
+
+    lbaint_t done = 0;
+
+    while (done < blkcnt) {
+        unsigned long count = min((unsigned long)(blkcnt - done), entry->max_blocks);
+
+        int ret = uboot_usbstor_read10(entry, udev, desc, start + done, count,
+            (uint8_t *) buffer + done * desc->blksz);
+        if (ret == 0) {
+            done += count;
+            continue;
+        }
+
+        // The device failed the command itself, which says nothing of the
+        // transfer size; report the blocks read before it.
+        if (ret == -EIO) {
+            UBOOT_LOGW("USB storage read of block %lu failed", (unsigned long)(start + done));
+            return done;
+        }
+
+        // Recover the transport, and negotiate down to a smaller transfer
+        // the device accepts, leaving it to the driver at the driver's own
+        // limit.
+        uboot_usbstor_reset(entry, udev);
+        entry->max_blocks /= 2;
+        UBOOT_LOGW("USB storage transfer reduced to %lu blocks", entry->max_blocks);
+
+        if (entry->max_blocks <= UBOOT_USBSTOR_DRIVER_BLOCKS) {
+            entry->max_blocks = 0;
+            return done + driver_ops->read(dev, start + done, blkcnt - done,
+                (uint8_t *) buffer + done * desc->blksz);
+        }
+    }
+
+    return done;
+}
+
+void uboot_usbstor_interpose(void)
+{
+    driver_ops = NULL;
+    memset(devices, 0, sizeof(devices));
+
+    for (int i = 0; i < _u_boot_driver_count; i++) {
+        struct driver *drv = &driver_data.driver_array[i];
+
+        if (drv->id != UCLASS_BLK || drv->ops == NULL ||
+            strcmp(drv->name, "usb_storage_blk") != 0)
+            continue;
+
+        driver_ops = drv->ops;
+        interposed_ops = *driver_ops;
+        interposed_ops.read = uboot_usbstor_read;
+        drv->ops = &interposed_ops;
+    }
+}
+
+void uboot_usbstor_forget(void)
+{
+    memset(devices, 0, sizeof(devices));
+}
+
+int uboot_usb_storage_set_max_transfer(unsigned long blocks)
+{
+    if (blocks > UBOOT_USBSTOR_MAX_BLOCKS)
+        return -EINVAL;
+
+    configured_blocks = blocks;
+
+    // Renegotiate with each device on its next read.
+    uboot_usbstor_forget();
+
+    return 0;
+}
+
+#else
+
+void uboot_usbstor_interpose(void) {}
+
+void uboot_usbstor_forget(void) {}
+
+int uboot_usb_storage_set_max_transfer(unsigned long blocks) { return -ENOSYS; }
+
+#endif
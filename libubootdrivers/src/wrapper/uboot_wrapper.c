@@ -21,6 +21,18 @@
 #include <env.h>
 #include <command.h>
 #include <sel4_timer.h>
+#ifdef CONFIG_DM_ETH
+#include <uboot_neigh.h>
+#endif
+#ifdef CONFIG_FEC_MXC
+#include <fec_ring.h>
+#include <fec_link.h>
+#endif
+#include <uboot_latency.h>
+#include <uboot_usbstor.h>
+#include <uboot_blkcache.h>
+#include <uboot_fs.h>
+#include "../../include/public_api/uboot_drivers.h"
 
 //libmicrokit
 #include <stdio.h>
@@ -81,6 +93,16 @@ int initialise_uboot_wrapper(char* fdt_blob)
     // Set up the driver data.
     initialise_driver_data();
 
+#ifdef CONFIG_DM_ETH
+    // Share the neighbour cache with the network commands.
+    uboot_neigh_interpose();
+#endif
+
+    // Read USB storage in large commands, and all block devices through the
+    // block cache.
+    uboot_usbstor_interpose();
+    uboot_blkcache_interpose();
+
     // Allocation of global_data.
     gd = malloc(sizeof(gd_t));
     if (gd == NULL)
@@ -182,6 +204,10 @@ error:
     return -1;
 }
 
+#ifdef CONFIG_DM_ETH
+static void uboot_eth_refresh_handle(void);
+#endif
+
 int run_uboot_command(char* cmd)
 {
     // Fail immediately if library not initialised.
@@ -190,9 +216,36 @@ int run_uboot_command(char* cmd)
 
     log_info("--- running command '%s' ---", cmd);
 
+    // The command may use the filesystems, replacing any file held open.
+    uboot_fs_release();
+
+    // The command may remove or replace block devices, so data held for
+    // them must reach the device first.
+    uboot_blkcache_flush(NULL);
+
     // Perform the command.
     int ret = run_command(cmd, CMD_FLAG_ENV);
 
+#ifdef CONFIG_DM_ETH
+    // The command may have changed the active ethernet device.
+    uboot_eth_refresh_handle();
+#endif
+
+    // USB commands may have enumerated the bus again.
+    uboot_usbstor_forget();
+
+    // A device may now hold a different medium (e.g. after 'mmc rescan'),
+    // or a new device may occupy the memory of one removed, so nothing
+    // cached by device remains valid once written by the command.
+    uboot_blkcache_flush(NULL);
+    uboot_blkcache_invalidate();
+
+#ifdef CONFIG_FEC_MXC
+    // Network commands restart the ethernet device, returning ownership of
+    // its descriptor rings to the driver. Reclaim them if necessary.
+    fec_ring_resync(eth_get_dev());
+#endif
+
     log_info("--- command '%s' completed with return code %i ---", cmd, ret);
 
     return ret;
@@ -207,6 +260,15 @@ void shutdown_uboot_wrapper(void)
     // Shutdown the monotonic timer.
     shutdown_timer();
 
+    // Close any file held open, then release the block cache.
+    uboot_fs_release();
+    uboot_blkcache_shutdown();
+
+#ifdef CONFIG_FEC_MXC
+    // Release the ethernet descriptor rings.
+    fec_ring_shutdown();
+#endif
+
     // Delete persistant state.
     free(gd);
     gd = NULL;
@@ -245,23 +307,273 @@ int uboot_stdin_getc(void)
 
 #ifdef CONFIG_DM_ETH
 
+/* Resolved ethernet device returned by uboot_eth_open. Only a single device
+ * is supported, so there is only ever one handle. */
+struct uboot_eth_handle {
+    struct udevice *dev;
+    const struct eth_ops *ops;
+};
+
+static struct uboot_eth_handle eth_handle;
+
+/* Completion callback for asynchronous transmission, and the number of frames
+ * completed when sent synchronously through the driver */
+static uboot_eth_tx_complete_t eth_tx_complete;
+static unsigned long eth_tx_completed;
+
+/* Traffic passed through the driver's own send and receive operations, i.e.
+ * not counted by the ring management */
+struct uboot_eth_path_stats {
+    unsigned long rx_packets;
+    unsigned long rx_bytes;
+    unsigned long rx_errors;
+    unsigned long tx_packets;
+    unsigned long tx_bytes;
+    unsigned long tx_errors;
+};
+
+static struct uboot_eth_path_stats eth_stats;
+
+/* Progress of ethernet initialisation, see uboot_eth_init_async */
+static int eth_link_state = UBOOT_ETH_LINK_HALTED;
+
+static inline int uboot_eth_count_tx(int ret, int length)
+{
+    if (ret < 0) {
+        eth_stats.tx_errors++;
+    } else {
+        eth_stats.tx_packets++;
+        eth_stats.tx_bytes += length;
+    }
+    return ret;
+}
+
+static inline int uboot_eth_count_rx(int ret)
+{
+    if (ret > 0) {
+        eth_stats.rx_packets++;
+        eth_stats.rx_bytes += ret;
+    } else if (ret < 0 && ret != -EAGAIN) {
+        eth_stats.rx_errors++;
+    }
+    return ret;
+}
+
+static void uboot_eth_refresh_handle(void)
+{
+    if (eth_handle.dev == NULL)
+        return;
+
+    // Invalidate the handle if the command left no device running, as
+    // uboot_eth_halt does.
+    struct udevice *current = eth_get_dev();
+    if (current == NULL || !eth_is_active(current)) {
+        eth_handle.dev = NULL;
+        eth_handle.ops = NULL;
+        eth_link_state = UBOOT_ETH_LINK_HALTED;
+        return;
+    }
+
+    eth_handle.dev = current;
+    eth_handle.ops = eth_get_ops(current);
+}
+
 int uboot_eth_init(void)
+{
+    return uboot_eth_init_config(NULL);
+}
+
+int uboot_eth_init_config(const struct uboot_eth_config *config)
 {
     // Return immediately if library not initialised .
     if (!library_initialised)
         return -1;
 
-    return eth_init();
+#ifdef CONFIG_FEC_MXC
+    if (config != NULL) {
+        struct fec_ring_config ring_config = {
+            .rx_size = config->rx_ring_size,
+            .rx_spare = config->rx_spare_buffers,
+            .tx_size = config->tx_ring_size,
+            .tx_pool = config->tx_buffers,
+            .buf_size = config->buffer_size,
+        };
+
+        int ret = fec_ring_configure(&ring_config);
+        if (ret < 0)
+            return ret;
+    }
+#endif
+
+    int ret = eth_init();
+    if (ret < 0)
+        return ret;
+
+    eth_link_state = UBOOT_ETH_LINK_UP;
+
+#ifdef CONFIG_FEC_MXC
+    // Take ownership of the descriptor rings to allow frames to be queued in
+    // batches and received without copying. On failure the driver's own
+    // path remains in use.
+    if (fec_ring_attach(eth_get_dev()) != 0)
+        UBOOT_LOGW("Unable to attach ethernet rings, using driver path");
+#endif
+
+    return ret;
 }
+
 void uboot_eth_halt(void)
 {
     // Return immediately if library not initialised .
     if (!library_initialised)
         return;
 
+    // Invalidate any open handle.
+    eth_handle.dev = NULL;
+    eth_handle.ops = NULL;
+    eth_link_state = UBOOT_ETH_LINK_HALTED;
+
+#ifdef CONFIG_FEC_MXC
+    fec_ring_detach();
+#endif
+
     eth_halt();
 }
 
+int uboot_eth_init_async(void)
+{
+    // Return immediately if library not initialised .
+    if (!library_initialised)
+        return -1;
+
+    int ret;
+
+    if (eth_link_state != UBOOT_ETH_LINK_HALTED)
+        return eth_link_state;
+
+#ifdef CONFIG_FEC_MXC
+    struct udevice *dev = eth_get_dev();
+
+    // Starting the driver waits for autonegotiation to complete. Unless the
+    // link is already up, leave negotiation to run in the background and
+    // start the driver once it has completed.
+    int link = fec_link_check(dev);
+    if (link >= 0 && link != FEC_LINK_UP) {
+        ret = fec_link_autoneg(dev);
+        if (ret < 0)
+            return ret;
+
+        eth_link_state = UBOOT_ETH_LINK_PENDING;
+        return eth_link_state;
+    }
+#endif
+
+    ret = uboot_eth_init();
+    if (ret < 0)
+        return ret;
+
+    return eth_link_state;
+}
+
+int uboot_eth_link_poll(void)
+{
+    // Return immediately if library not initialised .
+    if (!library_initialised)
+        return -1;
+
+#ifdef CONFIG_FEC_MXC
+    if (eth_link_state == UBOOT_ETH_LINK_PENDING &&
+        fec_link_check(eth_get_dev()) == FEC_LINK_UP) {
+        // Negotiation has completed, so the driver starts without waiting.
+        int ret = uboot_eth_init();
+        if (ret < 0) {
+            eth_link_state = UBOOT_ETH_LINK_HALTED;
+            return ret;
+        }
+    }
+#endif
+
+    return eth_link_state;
+}
+
+struct uboot_eth_handle *uboot_eth_open(void)
+{
+    // Return immediately if library not initialised .
+    if (!library_initialised)
+        return NULL;
+
+	struct udevice *current;
+
+	current = eth_get_dev();
+	if (!current || !eth_is_active(current))
+		return NULL;
+
+	eth_handle.dev = current;
+	eth_handle.ops = eth_get_ops(current);
+
+	return &eth_handle;
+}
+
+int uboot_eth_handle_send(struct uboot_eth_handle *handle, unsigned char *packet,
+	int length)
+{
+	// The device and its state were checked when the handle was opened; a
+	// halt clears the handle.
+	if (handle->dev == NULL)
+		return -ENODEV;
+
+#ifdef CONFIG_FEC_MXC
+	if (fec_ring_attached()) {
+		int ret = fec_ring_send(packet, length);
+		if (ret < 0)
+			eth_stats.tx_errors++;
+		return ret;
+	}
+#endif
+
+	return uboot_eth_count_tx(handle->ops->send(handle->dev, packet, length), length);
+}
+
+int uboot_eth_handle_receive(struct uboot_eth_handle *handle, unsigned char **packet)
+{
+	if (handle->dev == NULL)
+		return -ENODEV;
+
+#ifdef CONFIG_FEC_MXC
+	if (fec_ring_attached()) {
+		int length;
+		int ret = fec_ring_receive_burst(packet, &length, 1);
+		return (ret > 0) ? length : ret;
+	}
+#endif
+
+	int ret = uboot_eth_count_rx(handle->ops->recv(handle->dev, ETH_RECV_CHECK_DEVICE, packet));
+
+	if (ret == 0 && handle->ops->free_pkt)
+		handle->ops->free_pkt(handle->dev, *packet, ret);
+
+	if (ret == -EAGAIN)
+		ret = 0;
+
+	return ret;
+}
+
+int uboot_eth_handle_free_packet(struct uboot_eth_handle *handle, unsigned char **packet)
+{
+#ifdef CONFIG_FEC_MXC
+	if (fec_ring_is_packet(*packet))
+		return fec_ring_free_packet(*packet);
+#endif
+
+	if (handle->dev == NULL)
+		return -ENODEV;
+
+	if (handle->ops->free_pkt)
+		handle->ops->free_pkt(handle->dev, *packet, 0);
+
+	return 0;
+}
+
 int uboot_eth_send(unsigned char *packet, int length)
 {
     // Return immediately if library not initialised .
@@ -278,9 +590,52 @@ int uboot_eth_send(unsigned char *packet, int length)
 	if (!eth_is_active(current))
 		return -EINVAL;
 
+#ifdef CONFIG_FEC_MXC
+	if (fec_ring_attached()) {
+		ret = fec_ring_send(packet, length);
+		if (ret < 0)
+			eth_stats.tx_errors++;
+		return ret;
+	}
+#endif
+
 	ret = eth_get_ops(current)->send(current, packet, length);
 
-	return ret;
+	return uboot_eth_count_tx(ret, length);
+}
+
+int uboot_eth_send_burst(unsigned char **packets, int *lengths, int count)
+{
+    // Return immediately if library not initialised .
+    if (!library_initialised)
+        return -1;
+
+	struct udevice *current;
+	const struct eth_ops *ops;
+	int sent;
+
+	current = eth_get_dev();
+	if (!current)
+		return -ENODEV;
+
+	if (!eth_is_active(current))
+		return -EINVAL;
+
+#ifdef CONFIG_FEC_MXC
+	if (fec_ring_attached())
+		return fec_ring_send_burst(packets, lengths, count);
+#endif
+
+	// Fall back to sending each packet through the driver in turn.
+	ops = eth_get_ops(current);
+	for (sent = 0; sent < count; sent++) {
+		int ret = uboot_eth_count_tx(ops->send(current, packets[sent], lengths[sent]),
+			lengths[sent]);
+		if (ret < 0)
+			return (sent > 0) ? sent : ret;
+	}
+
+	return sent;
 }
 
 int uboot_eth_receive(unsigned char **packet)
@@ -298,7 +653,15 @@ int uboot_eth_receive(unsigned char **packet)
 	if (!eth_is_active(current))
 		return -EINVAL;
 
-    int ret = eth_get_ops(current)->recv(current, ETH_RECV_CHECK_DEVICE, packet);
+#ifdef CONFIG_FEC_MXC
+	if (fec_ring_attached()) {
+		int length;
+		int ret = fec_ring_receive_burst(packet, &length, 1);
+		return (ret > 0) ? length : ret;
+	}
+#endif
+
+    int ret = uboot_eth_count_rx(eth_get_ops(current)->recv(current, ETH_RECV_CHECK_DEVICE, packet));
 
     if (ret == 0 && eth_get_ops(current)->free_pkt)
         eth_get_ops(current)->free_pkt(current, *packet, ret);
@@ -318,6 +681,13 @@ int uboot_eth_free_packet(unsigned char **packet)
 	struct udevice *current;
     int ret = 0;
 
+#ifdef CONFIG_FEC_MXC
+	// Buffers loaned from the receive ring remain valid across a halt, so
+	// are identified by address rather than by the current ring state.
+	if (fec_ring_is_packet(*packet))
+		return fec_ring_free_packet(*packet);
+#endif
+
 	current = eth_get_dev();
 	if (!current)
 		return -ENODEV;
@@ -328,6 +698,307 @@ int uboot_eth_free_packet(unsigned char **packet)
 	return ret;
 }
 
+int uboot_eth_receive_burst(unsigned char **packets, int *lengths, int max)
+{
+    // Return immediately if library not initialised .
+    if (!library_initialised)
+        return -1;
+
+	struct udevice *current;
+	const struct eth_ops *ops;
+	int ret;
+
+	current = eth_get_dev();
+	if (!current)
+		return -ENODEV;
+
+	if (!eth_is_active(current))
+		return -EINVAL;
+
+#ifdef CONFIG_FEC_MXC
+	if (fec_ring_attached())
+		return fec_ring_receive_burst(packets, lengths, max);
+#endif
+
+	if (max < 1)
+		return 0;
+
+	// Without control of the receive ring at most one frame is returned.
+	// U-Boot drivers are free to hand back the same buffer on every call
+	// (fec_mxc always returns net_rx_packets[0]), so a second frame could
+	// overwrite the first before the client has seen it.
+	ops = eth_get_ops(current);
+	ret = uboot_eth_count_rx(ops->recv(current, ETH_RECV_CHECK_DEVICE, &packets[0]));
+
+	if (ret > 0) {
+		lengths[0] = ret;
+		return 1;
+	}
+
+	// The driver may hand back a buffer even when no frame was available;
+	// release it as uboot_eth_receive does.
+	if (ret == 0 && ops->free_pkt)
+		ops->free_pkt(current, packets[0], ret);
+
+	return (ret == -EAGAIN) ? 0 : ret;
+}
+
+int uboot_eth_free_packet_burst(unsigned char **packets, int count)
+{
+    // Return immediately if library not initialised .
+    if (!library_initialised)
+        return -1;
+
+	struct udevice *current;
+	const struct eth_ops *ops;
+	int ret = 0;
+
+	current = eth_get_dev();
+	if (!current)
+		return -ENODEV;
+
+	ops = eth_get_ops(current);
+
+	for (int i = 0; i < count; i++) {
+#ifdef CONFIG_FEC_MXC
+		if (fec_ring_is_packet(packets[i])) {
+			if (fec_ring_free_packet(packets[i]) != 0)
+				ret = -EINVAL;
+			continue;
+		}
+#endif
+		if (ops->free_pkt)
+			ops->free_pkt(current, packets[i], 0);
+	}
+
+	return ret;
+}
+
+int uboot_eth_irq_enable(int enable)
+{
+    // Return immediately if library not initialised .
+    if (!library_initialised)
+        return -1;
+
+#ifdef CONFIG_FEC_MXC
+	return fec_ring_irq_enable(enable != 0);
+#else
+	return -ENOSYS;
+#endif
+}
+
+int uboot_eth_irq_poll(unsigned char **packets, int *lengths, int budget)
+{
+    // Return immediately if library not initialised .
+    if (!library_initialised)
+        return -1;
+
+#ifdef CONFIG_FEC_MXC
+	if (fec_ring_attached())
+		return fec_ring_irq_poll(packets, lengths, budget);
+#endif
+
+	// Without control of the receive ring there is no interrupt to manage;
+	// simply drain the driver.
+	return uboot_eth_receive_burst(packets, lengths, budget);
+}
+
+int uboot_eth_set_coalescing(unsigned int rx_frames, unsigned int rx_usecs,
+	unsigned int tx_frames, unsigned int tx_usecs)
+{
+    // Return immediately if library not initialised .
+    if (!library_initialised)
+        return -1;
+
+#ifdef CONFIG_FEC_MXC
+	return fec_ring_set_coalescing(rx_frames, rx_usecs, tx_frames, tx_usecs);
+#else
+	return -ENOSYS;
+#endif
+}
+
+unsigned char *uboot_eth_alloc_tx_buffer(void)
+{
+    // Return immediately if library not initialised .
+    if (!library_initialised)
+        return NULL;
+
+#ifdef CONFIG_FEC_MXC
+	return fec_ring_alloc_tx_buffer();
+#else
+	return NULL;
+#endif
+}
+
+int uboot_eth_free_tx_buffer(unsigned char *buffer)
+{
+    // Return immediately if library not initialised .
+    if (!library_initialised)
+        return -1;
+
+#ifdef CONFIG_FEC_MXC
+	return fec_ring_free_tx_buffer(buffer);
+#else
+	return -EINVAL;
+#endif
+}
+
+void uboot_eth_set_tx_complete(uboot_eth_tx_complete_t callback)
+{
+	eth_tx_complete = callback;
+
+#ifdef CONFIG_FEC_MXC
+	fec_ring_set_tx_complete(callback);
+#endif
+}
+
+int uboot_eth_send_async(unsigned char *packet, int length, void *cookie)
+{
+    // Return immediately if library not initialised .
+    if (!library_initialised)
+        return -1;
+
+	int ret;
+
+#ifdef CONFIG_FEC_MXC
+	if (fec_ring_attached())
+		return fec_ring_send_async(packet, length, cookie);
+#endif
+
+	// Without control of the transmit ring the driver sends synchronously,
+	// so the frame is complete as soon as it returns.
+	ret = uboot_eth_send(packet, length);
+	if (ret < 0)
+		return ret;
+
+	eth_tx_completed++;
+	if (eth_tx_complete != NULL)
+		eth_tx_complete(cookie);
+
+	return 0;
+}
+
+int uboot_eth_tx_poll(void)
+{
+    // Return immediately if library not initialised .
+    if (!library_initialised)
+        return -1;
+
+#ifdef CONFIG_FEC_MXC
+	if (fec_ring_attached())
+		return fec_ring_tx_reclaim();
+#endif
+
+	return 0;
+}
+
+unsigned long uboot_eth_tx_completed(void)
+{
+	unsigned long completed = eth_tx_completed;
+
+#ifdef CONFIG_FEC_MXC
+	completed += fec_ring_tx_completed();
+#endif
+
+	return completed;
+}
+
+int uboot_eth_get_ring_stats(struct uboot_eth_ring_stats *stats)
+{
+    // Return immediately if library not initialised .
+    if (!library_initialised)
+        return -1;
+
+#ifdef CONFIG_FEC_MXC
+	struct fec_ring_stats ring_stats;
+
+	fec_ring_get_stats(&ring_stats);
+
+	stats->rx_frames = ring_stats.rx_frames;
+	stats->rx_errors = ring_stats.rx_errors;
+	stats->rx_pool_empty = ring_stats.rx_pool_empty;
+	stats->rx_overflow = ring_stats.rx_overflow;
+	stats->tx_frames = ring_stats.tx_frames;
+	stats->tx_ring_full = ring_stats.tx_ring_full;
+
+	return 0;
+#else
+	return -ENOSYS;
+#endif
+}
+
+static void uboot_eth_latency_summary(const struct uboot_latency *latency,
+	struct uboot_eth_latency *summary)
+{
+	summary->count = latency->count;
+	summary->p50_ns = uboot_latency_ticks_to_ns(uboot_latency_percentile(latency, 50));
+	summary->p99_ns = uboot_latency_ticks_to_ns(uboot_latency_percentile(latency, 99));
+	summary->max_ns = uboot_latency_ticks_to_ns(latency->max);
+}
+
+int uboot_eth_get_stats(struct uboot_eth_stats *stats)
+{
+    // Return immediately if library not initialised .
+    if (!library_initialised)
+        return -1;
+
+	memset(stats, 0, sizeof(*stats));
+
+	stats->rx_packets = eth_stats.rx_packets;
+	stats->rx_bytes = eth_stats.rx_bytes;
+	stats->rx_errors = eth_stats.rx_errors;
+	stats->tx_packets = eth_stats.tx_packets;
+	stats->tx_bytes = eth_stats.tx_bytes;
+	stats->tx_errors = eth_stats.tx_errors;
+
+#ifdef CONFIG_FEC_MXC
+	struct fec_ring_stats ring_stats;
+	struct uboot_latency tx_latency;
+	struct uboot_latency rx_hold;
+
+	fec_ring_get_stats(&ring_stats);
+	fec_ring_get_latency(&tx_latency, &rx_hold);
+
+	stats->rx_packets += ring_stats.rx_frames;
+	stats->rx_bytes += ring_stats.rx_bytes;
+	stats->rx_errors += ring_stats.rx_errors;
+	stats->rx_dropped = ring_stats.rx_overflow;
+	stats->tx_packets += ring_stats.tx_frames;
+	stats->tx_bytes += ring_stats.tx_bytes;
+	stats->tx_ring_full = ring_stats.tx_ring_full;
+	stats->tx_in_flight = ring_stats.tx_in_flight;
+	stats->rx_held = ring_stats.rx_held;
+
+	uboot_eth_latency_summary(&tx_latency, &stats->tx_latency);
+	uboot_eth_latency_summary(&rx_hold, &stats->rx_hold);
+#endif
+
+	return 0;
+}
+
+void uboot_eth_reset_stats(void)
+{
+	memset(&eth_stats, 0, sizeof(eth_stats));
+
+#ifdef CONFIG_FEC_MXC
+	fec_ring_reset_stats();
+#endif
+}
+
+int uboot_eth_enable_timestamps(int enable)
+{
+    // Return immediately if library not initialised .
+    if (!library_initialised)
+        return -1;
+
+#ifdef CONFIG_FEC_MXC
+	fec_ring_enable_timestamps(enable != 0);
+	return 0;
+#else
+	return -ENOSYS;
+#endif
+}
+
 unsigned char *uboot_eth_get_ethaddr(void)
 {
     // Return immediately if library not initialised .
@@ -340,10 +1011,35 @@ unsigned char *uboot_eth_get_ethaddr(void)
 #else
 
 int uboot_eth_init(void) { return 0; }
+int uboot_eth_init_config(const struct uboot_eth_config *config) { return 0; }
+int uboot_eth_init_async(void) { return 0; }
+int uboot_eth_link_poll(void) { return 0; }
 void uboot_eth_halt(void) {}
+struct uboot_eth_handle *uboot_eth_open(void) { return NULL; }
+int uboot_eth_handle_send(struct uboot_eth_handle *handle, unsigned char *packet,
+    int length) { return 0; }
+int uboot_eth_handle_receive(struct uboot_eth_handle *handle, unsigned char **packet) { return 0; }
+int uboot_eth_handle_free_packet(struct uboot_eth_handle *handle, unsigned char **packet) { return 0; }
 int uboot_eth_send(unsigned char *packet, int length) { return 0; }
+int uboot_eth_send_burst(unsigned char **packets, int *lengths, int count) { return 0; }
 int uboot_eth_receive(unsigned char **packet) { return 0; }
 int uboot_eth_free_packet(unsigned char **packet) { return 0; }
+int uboot_eth_receive_burst(unsigned char **packets, int *lengths, int max) { return 0; }
+int uboot_eth_free_packet_burst(unsigned char **packets, int count) { return 0; }
+int uboot_eth_irq_enable(int enable) { return 0; }
+int uboot_eth_irq_poll(unsigned char **packets, int *lengths, int budget) { return 0; }
+int uboot_eth_set_coalescing(unsigned int rx_frames, unsigned int rx_usecs,
+    unsigned int tx_frames, unsigned int tx_usecs) { return 0; }
+unsigned char *uboot_eth_alloc_tx_buffer(void) { return NULL; }
+int uboot_eth_free_tx_buffer(unsigned char *buffer) { return 0; }
+void uboot_eth_set_tx_complete(uboot_eth_tx_complete_t callback) {}
+int uboot_eth_send_async(unsigned char *packet, int length, void *cookie) { return 0; }
+int uboot_eth_tx_poll(void) { return 0; }
+unsigned long uboot_eth_tx_completed(void) { return 0; }
+int uboot_eth_get_ring_stats(struct uboot_eth_ring_stats *stats) { return 0; }
+int uboot_eth_get_stats(struct uboot_eth_stats *stats) { return 0; }
+void uboot_eth_reset_stats(void) {}
+int uboot_eth_enable_timestamps(int enable) { return 0; }
 unsigned char *uboot_eth_get_ethaddr(void) { return 0; }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Checksum kernels for the packet path
+ *
+ * The Internet checksum (RFC 1071) and the CRC-32 of IEEE 802.3 (as used by
+ * ethernet, zlib and gzip) are provided with implementations selected for
+ * the architecture at compile time:
+ *
+ *  - aarch64: ASIMD (NEON) for the Internet checksum, and the ARMv8 CRC32
+ *    instructions for CRC-32.
+ *  - x86: SSE2 (or AVX2 where enabled) for the Internet checksum.
+ *  - otherwise: portable scalar versions, summing 64 bits at a time for the
+ *    Internet checksum and slicing by 8 bytes for CRC-32.
+ *
+ * The scalar versions are always available under their own names so the
+ * accelerated versions can be tested and benchmarked against them.
+ */
+
+/*
+ * Accumulate the Internet checksum of 'len' bytes at 'data' into a partial
+ * sum. A checksum over several regions (e.g. a pseudo header and a payload)
+ * is built by passing the result of one call as 'sum' to the next; every
+ * region but the last must be of even length. The partial sum is kept in
+ * the byte order of the data, i.e. values added directly to it must be in
+ * network byte order.
+ *
+ * The result is reduced to 16 bits, but not complemented.
+ */
+uint32_t inet_csum_partial(const void *data, size_t len, uint32_t sum);
+uint32_t inet_csum_partial_scalar(const void *data, size_t len, uint32_t sum);
+
+/* Reduce a wide partial sum to 16 bits */
+static inline uint32_t inet_csum_reduce(uint64_t sum)
+{
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    return sum;
+}
+
+/* Complete a checksum from a partial sum, ready to be stored in a header */
+static inline uint16_t inet_csum_fold(uint32_t sum)
+{
+    return ~inet_csum_reduce(sum) & 0xffff;
+}
+
+/*
+ * Calculate the Internet checksum of 'len' bytes at 'data'. Over data which
+ * includes its checksum field the result is zero if the checksum is valid.
+ */
+static inline uint16_t inet_checksum(const void *data, size_t len)
+{
+    return inet_csum_fold(inet_csum_partial(data, len, 0));
+}
+
+/*
+ * Update a CRC-32 with 'len' bytes at 'data'. The initial and final values
+ * are complemented as for zlib's crc32(); the CRC of a buffer is given by
+ * crc32_update(0, data, len), and may be computed in pieces by passing the
+ * result of one call to the next.
+ */
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len);
+uint32_t crc32_update_scalar(uint32_t crc, const void *data, size_t len);
+
+/*
+ * The accelerated kernels, each declared where the target provides it. They
+ * are defined in src/arch/<arch>/checksum.c and are selected by
+ * inet_csum_partial and crc32_update; they are declared here so that tests
+ * and benchmarks may call them directly.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#define CHECKSUM_X86
+#endif
+
+#if defined(__aarch64__)
+uint32_t inet_csum_partial_neon(const void *data, size_t len, uint32_t sum);
+uint32_t crc32_update_armv8(uint32_t crc, const void *data, size_t len);
+#endif
+
+#if defined(CHECKSUM_X86) && defined(__SSE2__)
+uint32_t inet_csum_partial_sse2(const void *data, size_t len, uint32_t sum);
+#endif
+
+#if defined(CHECKSUM_X86) && defined(__AVX2__)
+uint32_t inet_csum_partial_avx2(const void *data, size_t len, uint32_t sum);
+#endif
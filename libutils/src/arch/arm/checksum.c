@@ -0,0 +1,102 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <utils/checksum.h>
+
+#ifdef __aarch64__
+
+#include <string.h>
+#include <arm_neon.h>
+#include <arm_acle.h>
+
+/* The CRC32 instructions are optional in ARMv8.0 (though implemented by all
+ * cores this library targets, from the Cortex-A53 on) so are enabled for the
+ * functions which use them rather than for the whole build. */
+#if defined(__ARM_FEATURE_CRC32)
+#define CRC32_TARGET
+#elif defined(__clang__)
+#define CRC32_TARGET __attribute__((target("crc")))
+#else
+#define CRC32_TARGET __attribute__((target("+crc")))
+#endif
+
+/* Number of 64 byte blocks which may be summed before the 32 bit lanes of
+ * the accumulators could overflow */
+#define CSUM_BLOCKS_PER_FLUSH 8192
+
+uint32_t inet_csum_partial_neon(const void *data, size_t len, uint32_t sum)
+{
+    const uint8_t *p = data;
+    uint64_t acc = sum;
+
+    while (len >= 64) {
+        uint32x4_t acc0 = vdupq_n_u32(0);
+        uint32x4_t acc1 = vdupq_n_u32(0);
+        size_t blocks = len / 64;
+
+        if (blocks > CSUM_BLOCKS_PER_FLUSH) {
+            blocks = CSUM_BLOCKS_PER_FLUSH;
+        }
+        len -= blocks * 64;
+
+        /* Add adjacent 16 bit words into 32 bit lanes, using two
+         * accumulators to keep independent additions in flight */
+        while (blocks-- > 0) {
+            acc0 = vpadalq_u16(acc0, vld1q_u16((const uint16_t *)(p + 0)));
+            acc1 = vpadalq_u16(acc1, vld1q_u16((const uint16_t *)(p + 16)));
+            acc0 = vpadalq_u16(acc0, vld1q_u16((const uint16_t *)(p + 32)));
+            acc1 = vpadalq_u16(acc1, vld1q_u16((const uint16_t *)(p + 48)));
+            p += 64;
+        }
+
+        acc += vaddlvq_u32(acc0) + vaddlvq_u32(acc1);
+    }
+
+    return inet_csum_partial_scalar(p, len, inet_csum_reduce(acc));
+}
+
+CRC32_TARGET uint32_t crc32_update_armv8(uint32_t crc, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+
+    crc = ~crc;
+
+    /* Align to 8 bytes so the main loop loads whole doublewords */
+    while (len > 0 && ((uintptr_t) p & 7) != 0) {
+        crc = __crc32b(crc, *p);
+        p++;
+        len--;
+    }
+
+    while (len >= 32) {
+        uint64_t words[4];
+        memcpy(words, p, sizeof(words));
+        crc = __crc32d(crc, words[0]);
+        crc = __crc32d(crc, words[1]);
+        crc = __crc32d(crc, words[2]);
+        crc = __crc32d(crc, words[3]);
+        p += 32;
+        len -= 32;
+    }
+
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        crc = __crc32d(crc, word);
+        p += 8;
+        len -= 8;
+    }
+
+    while (len > 0) {
+        crc = __crc32b(crc, *p);
+        p++;
+        len--;
+    }
+
+    return ~crc;
+}
+
+#endif /* __aarch64__ */
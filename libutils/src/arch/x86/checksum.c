@@ -0,0 +1,101 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <utils/checksum.h>
+
+/* The CRC32 instruction of SSE4.2 calculates CRC-32C (Castagnoli) rather
+ * than the IEEE 802.3 CRC, so CRC-32 uses the portable implementation. */
+
+/* Number of 64 byte blocks which may be summed before the 32 bit lanes of
+ * the accumulators could overflow */
+#define CSUM_BLOCKS_PER_FLUSH 8192
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+uint32_t inet_csum_partial_avx2(const void *data, size_t len, uint32_t sum)
+{
+    const uint8_t *p = data;
+    const __m256i zero = _mm256_setzero_si256();
+    uint64_t acc = sum;
+
+    while (len >= 64) {
+        __m256i acc0 = _mm256_setzero_si256();
+        __m256i acc1 = _mm256_setzero_si256();
+        size_t blocks = len / 64;
+        uint64_t lanes[4];
+
+        if (blocks > CSUM_BLOCKS_PER_FLUSH) {
+            blocks = CSUM_BLOCKS_PER_FLUSH;
+        }
+        len -= blocks * 64;
+
+        /* Widen 16 bit words to 32 bits by interleaving with zero, then add */
+        while (blocks-- > 0) {
+            __m256i v0 = _mm256_loadu_si256((const __m256i *)(p + 0));
+            __m256i v1 = _mm256_loadu_si256((const __m256i *)(p + 32));
+            acc0 = _mm256_add_epi32(acc0, _mm256_unpacklo_epi16(v0, zero));
+            acc1 = _mm256_add_epi32(acc1, _mm256_unpackhi_epi16(v0, zero));
+            acc0 = _mm256_add_epi32(acc0, _mm256_unpacklo_epi16(v1, zero));
+            acc1 = _mm256_add_epi32(acc1, _mm256_unpackhi_epi16(v1, zero));
+            p += 64;
+        }
+
+        /* Widen the lanes to 64 bits to sum them */
+        __m256i wide = _mm256_add_epi64(
+                           _mm256_add_epi64(_mm256_unpacklo_epi32(acc0, zero), _mm256_unpackhi_epi32(acc0, zero)),
+                           _mm256_add_epi64(_mm256_unpacklo_epi32(acc1, zero), _mm256_unpackhi_epi32(acc1, zero)));
+        _mm256_storeu_si256((__m256i *) lanes, wide);
+        acc += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+
+    return inet_csum_partial_scalar(p, len, inet_csum_reduce(acc));
+}
+
+#endif
+
+#if defined(__SSE2__)
+
+#include <emmintrin.h>
+
+uint32_t inet_csum_partial_sse2(const void *data, size_t len, uint32_t sum)
+{
+    const uint8_t *p = data;
+    const __m128i zero = _mm_setzero_si128();
+    uint64_t acc = sum;
+
+    while (len >= 64) {
+        __m128i acc0 = _mm_setzero_si128();
+        __m128i acc1 = _mm_setzero_si128();
+        size_t blocks = len / 64;
+        uint32_t lanes[4];
+
+        if (blocks > CSUM_BLOCKS_PER_FLUSH) {
+            blocks = CSUM_BLOCKS_PER_FLUSH;
+        }
+        len -= blocks * 64;
+
+        /* Widen 16 bit words to 32 bits by interleaving with zero, then add */
+        while (blocks-- > 0) {
+            for (int i = 0; i < 64; i += 16) {
+                __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+                acc0 = _mm_add_epi32(acc0, _mm_unpacklo_epi16(v, zero));
+                acc1 = _mm_add_epi32(acc1, _mm_unpackhi_epi16(v, zero));
+            }
+            p += 64;
+        }
+
+        _mm_storeu_si128((__m128i *) lanes, acc0);
+        acc += (uint64_t) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        _mm_storeu_si128((__m128i *) lanes, acc1);
+        acc += (uint64_t) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+
+    return inet_csum_partial_scalar(p, len, inet_csum_reduce(acc));
+}
+
+#endif
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdbool.h>
+#include <string.h>
+#include <utils/checksum.h>
+
+/* Reflected polynomial of the IEEE 802.3 CRC-32 */
+#define CRC32_POLY 0xedb88320
+
+/* Tables for slice-by-8 CRC calculation, generated on first use */
+static uint32_t crc32_table[8][256];
+static bool crc32_table_ready;
+
+uint32_t inet_csum_partial_scalar(const void *data, size_t len, uint32_t sum)
+{
+    const uint8_t *p = data;
+    uint64_t acc = sum;
+
+    /* The one's complement sum of 16 bit words can be formed from a sum of
+     * wider words, the carries out of each 16 bits being folded back in at
+     * the end. Sum 32 bit halves into a 64 bit accumulator, which cannot
+     * overflow for any realistic length. */
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        acc += (word & 0xffffffff) + (word >> 32);
+        p += 8;
+        len -= 8;
+    }
+
+    if (len >= 4) {
+        uint32_t word;
+        memcpy(&word, p, sizeof(word));
+        acc += word;
+        p += 4;
+        len -= 4;
+    }
+
+    if (len >= 2) {
+        uint16_t word;
+        memcpy(&word, p, sizeof(word));
+        acc += word;
+        p += 2;
+        len -= 2;
+    }
+
+    /* A trailing byte is padded with zero to form the final word */
+    if (len > 0) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        acc += *p;
+#else
+        acc += (uint32_t) *p << 8;
+#endif
+    }
+
+    return inet_csum_reduce(acc);
+}
+
+/* The kernels are selected here, at compile time, rather than by overriding
+ * weak definitions: the library is a static archive, from which the linker
+ * would never extract an object providing only an override. */
+uint32_t inet_csum_partial(const void *data, size_t len, uint32_t sum)
+{
+#if defined(__aarch64__)
+    return inet_csum_partial_neon(data, len, sum);
+#elif defined(CHECKSUM_X86) && defined(__AVX2__)
+    return inet_csum_partial_avx2(data, len, sum);
+#elif defined(CHECKSUM_X86) && defined(__SSE2__)
+    return inet_csum_partial_sse2(data, len, sum);
+#else
+    return inet_csum_partial_scalar(data, len, sum);
+#endif
+}
+
+static void crc32_init_table(void)
+{
+    for (int i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ CRC32_POLY : crc >> 1;
+        }
+        crc32_table[0][i] = crc;
+    }
+
+    /* Table 'n' gives the effect of a byte followed by 'n' zero bytes */
+    for (int i = 0; i < 256; i++) {
+        for (int n = 1; n < 8; n++) {
+            uint32_t prev = crc32_table[n - 1][i];
+            crc32_table[n][i] = (prev >> 8) ^ crc32_table[0][prev & 0xff];
+        }
+    }
+
+    crc32_table_ready = true;
+}
+
+uint32_t crc32_update_scalar(uint32_t crc, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+
+    if (!crc32_table_ready) {
+        crc32_init_table();
+    }
+
+    crc = ~crc;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    /* Process 8 bytes per step with independent table lookups */
+    while (len >= 8) {
+        uint32_t one, two;
+        memcpy(&one, p, sizeof(one));
+        memcpy(&two, p + 4, sizeof(two));
+        one ^= crc;
+        crc = crc32_table[7][one & 0xff] ^
+              crc32_table[6][(one >> 8) & 0xff] ^
+              crc32_table[5][(one >> 16) & 0xff] ^
+              crc32_table[4][one >> 24] ^
+              crc32_table[3][two & 0xff] ^
+              crc32_table[2][(two >> 8) & 0xff] ^
+              crc32_table[1][(two >> 16) & 0xff] ^
+              crc32_table[0][two >> 24];
+        p += 8;
+        len -= 8;
+    }
+#endif
+
+    while (len > 0) {
+        crc = crc32_table[0][(crc ^ *p) & 0xff] ^ (crc >> 8);
+        p++;
+        len--;
+    }
+
+    return ~crc;
+}
+
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len)
+{
+#if defined(__aarch64__)
+    return crc32_update_armv8(crc, data, len);
+#else
+    return crc32_update_scalar(crc, data, len);
+#endif
+}
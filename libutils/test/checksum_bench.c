@@ -0,0 +1,94 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Throughput of each checksum kernel, in MB/s, over packet sized and large
+ * buffers. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <utils/checksum.h>
+
+#define BUFFER_SIZE (64 * 1024)
+
+/* Bytes processed by each measurement */
+#define BENCH_BYTES (512ull * 1024 * 1024)
+
+typedef uint32_t (*csum_fn_t)(const void *data, size_t len, uint32_t sum);
+typedef uint32_t (*crc_fn_t)(uint32_t crc, const void *data, size_t len);
+
+static uint8_t buffer[BUFFER_SIZE];
+
+static const size_t sizes[] = { 64, 1500, 9000, BUFFER_SIZE };
+
+/* Consumed so that the calls cannot be optimised away */
+static volatile uint32_t sink;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench_csum(const char *name, csum_fn_t fn)
+{
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        unsigned long long iterations = BENCH_BYTES / sizes[s];
+        uint32_t sum = 0;
+
+        double start = now();
+        for (unsigned long long i = 0; i < iterations; i++) {
+            sum += fn(buffer, sizes[s], 0);
+        }
+        double elapsed = now() - start;
+        sink = sum;
+
+        printf("%-24s %6zu bytes %8.0f MB/s\n", name, sizes[s], BENCH_BYTES / elapsed / 1e6);
+    }
+}
+
+static void bench_crc(const char *name, crc_fn_t fn)
+{
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        unsigned long long iterations = BENCH_BYTES / sizes[s];
+        uint32_t crc = 0;
+
+        double start = now();
+        for (unsigned long long i = 0; i < iterations; i++) {
+            crc = fn(crc, buffer, sizes[s]);
+        }
+        double elapsed = now() - start;
+        sink = crc;
+
+        printf("%-24s %6zu bytes %8.0f MB/s\n", name, sizes[s], BENCH_BYTES / elapsed / 1e6);
+    }
+}
+
+int main(void)
+{
+    for (size_t i = 0; i < sizeof(buffer); i++) {
+        buffer[i] = i * 7;
+    }
+
+    bench_csum("inet_csum_partial_scalar", inet_csum_partial_scalar);
+#if defined(__aarch64__)
+    bench_csum("inet_csum_partial_neon", inet_csum_partial_neon);
+#endif
+#if defined(CHECKSUM_X86) && defined(__SSE2__)
+    bench_csum("inet_csum_partial_sse2", inet_csum_partial_sse2);
+#endif
+#if defined(CHECKSUM_X86) && defined(__AVX2__)
+    bench_csum("inet_csum_partial_avx2", inet_csum_partial_avx2);
+#endif
+
+    bench_crc("crc32_update_scalar", crc32_update_scalar);
+#if defined(__aarch64__)
+    bench_crc("crc32_update_armv8", crc32_update_armv8);
+#endif
+
+    return 0;
+}
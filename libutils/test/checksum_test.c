@@ -0,0 +1,128 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Tests of the checksum kernels against the scalar reference, over odd
+ * lengths, unaligned starts and data chosen to carry heavily. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <utils/checksum.h>
+
+#define BUFFER_SIZE (70 * 1024)
+
+typedef uint32_t (*csum_fn_t)(const void *data, size_t len, uint32_t sum);
+typedef uint32_t (*crc_fn_t)(uint32_t crc, const void *data, size_t len);
+
+static uint8_t buffer[BUFFER_SIZE + 64];
+static int failures;
+
+static void check(int ok, const char *name, size_t offset, size_t len)
+{
+    if (!ok) {
+        printf("FAIL %s offset %zu length %zu\n", name, offset, len);
+        failures++;
+    }
+}
+
+/* Lengths around each block size of the kernels, and long runs */
+static const size_t lengths[] = {
+    0, 1, 2, 3, 7, 8, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, 128, 129,
+    255, 256, 1499, 1500, 1514, 4095, 4096, 9001, 65535, BUFFER_SIZE
+};
+
+static void test_csum(const char *name, csum_fn_t fn)
+{
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        for (size_t offset = 0; offset < 8; offset++) {
+            size_t len = lengths[l];
+            uint32_t expect = inet_csum_partial_scalar(buffer + offset, len, 0);
+
+            check(fn(buffer + offset, len, 0) == expect, name, offset, len);
+
+            /* A carried in partial sum, as from a pseudo header */
+            expect = inet_csum_partial_scalar(buffer + offset, len, 0xfffe);
+            check(fn(buffer + offset, len, 0xfffe) == expect, name, offset, len);
+        }
+    }
+}
+
+static void test_crc(const char *name, crc_fn_t fn)
+{
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        for (size_t offset = 0; offset < 8; offset++) {
+            size_t len = lengths[l];
+            uint32_t expect = crc32_update_scalar(0, buffer + offset, len);
+
+            check(fn(0, buffer + offset, len) == expect, name, offset, len);
+
+            /* Computed in two pieces */
+            size_t half = len / 2;
+            check(fn(fn(0, buffer + offset, half), buffer + offset + half, len - half) == expect,
+                  name, offset, len);
+        }
+    }
+}
+
+static void test_kernels(void)
+{
+    test_csum("inet_csum_partial", inet_csum_partial);
+    test_crc("crc32_update", crc32_update);
+#if defined(__aarch64__)
+    test_csum("inet_csum_partial_neon", inet_csum_partial_neon);
+    test_crc("crc32_update_armv8", crc32_update_armv8);
+#endif
+#if defined(CHECKSUM_X86) && defined(__SSE2__)
+    test_csum("inet_csum_partial_sse2", inet_csum_partial_sse2);
+#endif
+#if defined(CHECKSUM_X86) && defined(__AVX2__)
+    test_csum("inet_csum_partial_avx2", inet_csum_partial_avx2);
+#endif
+}
+
+int main(void)
+{
+    static const char check_string[] = "123456789";
+
+    /* Known values: the CRC-32 check value, and the example of RFC 1071 */
+    static const uint8_t rfc1071[] = { 0x00, 0x01, 0xf2, 0x03, 0xf4, 0xf5, 0xf6, 0xf7 };
+    uint16_t expect_sum = 0xddf2;
+
+    check(crc32_update(0, check_string, 9) == 0xcbf43926, "crc32 check value", 0, 9);
+    check(crc32_update_scalar(0, check_string, 9) == 0xcbf43926, "crc32 check value", 0, 9);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    expect_sum = 0xf2dd;
+#endif
+    check(inet_csum_partial(rfc1071, sizeof(rfc1071), 0) == expect_sum, "rfc1071 sum", 0, 8);
+
+    /* Every word 0xffff, carrying out of every addition */
+    memset(buffer, 0xff, sizeof(buffer));
+    test_kernels();
+
+    /* Alternating maximum and minimum bytes */
+    for (size_t i = 0; i < sizeof(buffer); i++) {
+        buffer[i] = (i & 1) ? 0x00 : 0xff;
+    }
+    test_kernels();
+
+    /* Pseudo random data */
+    uint32_t x = 0x2545f491;
+    for (size_t i = 0; i < sizeof(buffer); i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        buffer[i] = x;
+    }
+    test_kernels();
+
+    if (failures > 0) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,185 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ */
+
+#include <string.h>
+#include <utils/base64.h>
+#include <utils/cbor64.h>
+#include <blk_bench.h>
+#include <uboot_drivers.h>
+
+/* Seed of the random workloads, fixed so that runs are comparable */
+#define BLK_BENCH_SEED  0x2545f491
+
+static const char *workload_names[] = {
+    [UBOOT_BLK_BENCH_SEQ_READ] = "seq_read",
+    [UBOOT_BLK_BENCH_SEQ_WRITE] = "seq_write",
+    [UBOOT_BLK_BENCH_RAND_READ] = "rand_read",
+    [UBOOT_BLK_BENCH_RAND_WRITE] = "rand_write",
+};
+
+static const char *codec_names[] = {
+    [UBOOT_FS_CODEC_NONE] = "none",
+    [UBOOT_FS_CODEC_LZ4] = "lz4",
+    [UBOOT_FS_CODEC_GZIP] = "gzip",
+};
+
+static void blk_bench_emit_uint(base64_t *streamer, const char *key, uint64_t value) {
+    cbor64_utf8(streamer, (char *) key);
+    cbor64_uint(streamer, value);
+}
+
+static void blk_bench_emit_string(base64_t *streamer, const char *key, const char *value) {
+    cbor64_utf8(streamer, (char *) key);
+    cbor64_utf8(streamer, (char *) value);
+}
+
+static void blk_bench_emit(base64_t *streamer, const blk_bench_target_t *target,
+                           const struct uboot_blk_bench_config *config, int error,
+                           const struct uboot_blk_bench_result *result) {
+    cbor64_map_start(streamer);
+
+    blk_bench_emit_string(streamer, "target", target->name);
+    blk_bench_emit_string(streamer, "iface", target->iface);
+    blk_bench_emit_string(streamer, "kind", (target->path != NULL) ? "file" : "raw");
+    blk_bench_emit_string(streamer, "workload", workload_names[config->workload]);
+    blk_bench_emit_uint(streamer, "io_size", config->io_size);
+    cbor64_utf8(streamer, "error");
+    cbor64_int(streamer, error);
+
+    if (error == 0) {
+        blk_bench_emit_uint(streamer, "operations", result->operations);
+        blk_bench_emit_uint(streamer, "bytes", result->bytes);
+        blk_bench_emit_uint(streamer, "elapsed_us", result->elapsed_us);
+        blk_bench_emit_uint(streamer, "kib_per_s", result->kib_per_s);
+        blk_bench_emit_uint(streamer, "p50_ns", result->p50_ns);
+        blk_bench_emit_uint(streamer, "p90_ns", result->p90_ns);
+        blk_bench_emit_uint(streamer, "p99_ns", result->p99_ns);
+        blk_bench_emit_uint(streamer, "max_ns", result->max_ns);
+    }
+
+    cbor64_map_end(streamer);
+}
+
+int blk_bench_run_suite(const blk_bench_target_t *targets, int target_count,
+                        const unsigned long *io_sizes, int io_size_count,
+                        unsigned long long total, FILE *output) {
+    base64_t streamer = base64_new(output);
+    int failures = 0;
+
+    if (targets == NULL || io_sizes == NULL || output == NULL) {
+        return -1;
+    }
+
+    cbor64_array_start(&streamer);
+
+    for (int t = 0; t < target_count; t++) {
+        const blk_bench_target_t *target = &targets[t];
+
+        for (int s = 0; s < io_size_count; s++) {
+            for (int workload = UBOOT_BLK_BENCH_SEQ_READ; workload <= UBOOT_BLK_BENCH_RAND_WRITE;
+                 workload++) {
+                bool write = workload == UBOOT_BLK_BENCH_SEQ_WRITE ||
+                    workload == UBOOT_BLK_BENCH_RAND_WRITE;
+                struct uboot_blk_bench_config config;
+                struct uboot_blk_bench_result result;
+
+                if (write && !target->writes) {
+                    continue;
+                }
+
+                memset(&config, 0, sizeof(config));
+                config.iface = target->iface;
+                config.devnum = target->devnum;
+                config.part = target->part;
+                config.path = target->path;
+                config.workload = workload;
+                config.io_size = io_sizes[s];
+                config.total = total;
+                config.lba_start = target->lba_start;
+                config.lba_count = target->lba_count;
+                config.seed = BLK_BENCH_SEED;
+
+                int error = uboot_blk_bench_run(&config, &result);
+                if (error != 0) {
+                    failures++;
+                }
+
+                blk_bench_emit(&streamer, target, &config, error, &result);
+            }
+        }
+    }
+
+    cbor64_array_end(&streamer);
+    base64_terminate(&streamer);
+
+    return failures;
+}
+
+static int blk_bench_load_file(base64_t *streamer, const blk_bench_load_t *load, const char *path,
+                               int codec, void *buffer, unsigned long buffer_size) {
+    struct uboot_fs_load_stats stats;
+
+    long ret = uboot_fs_load(load->iface, load->part, path, codec, buffer, buffer_size, &stats);
+    int error = (ret < 0) ? ret : 0;
+
+    cbor64_map_start(streamer);
+
+    blk_bench_emit_string(streamer, "path", path);
+    blk_bench_emit_string(streamer, "codec", codec_names[codec]);
+    cbor64_utf8(streamer, "error");
+    cbor64_int(streamer, error);
+
+    if (error == 0) {
+        blk_bench_emit_uint(streamer, "file_bytes", stats.file_bytes);
+        blk_bench_emit_uint(streamer, "loaded_bytes", stats.loaded_bytes);
+        blk_bench_emit_uint(streamer, "read_us", stats.read_us);
+        blk_bench_emit_uint(streamer, "decompress_us", stats.decompress_us);
+        blk_bench_emit_uint(streamer, "elapsed_us", stats.elapsed_us);
+    }
+
+    cbor64_map_end(streamer);
+
+    return error;
+}
+
+int blk_bench_compare_load(const blk_bench_load_t *load, void *buffer,
+                           unsigned long buffer_size, FILE *output) {
+    base64_t streamer = base64_new(output);
+    int failures = 0;
+
+    if (load == NULL || load->plain_path == NULL || buffer == NULL || output == NULL) {
+        return -1;
+    }
+
+    const char *paths[] = {
+        [UBOOT_FS_CODEC_NONE] = load->plain_path,
+        [UBOOT_FS_CODEC_LZ4] = load->lz4_path,
+        [UBOOT_FS_CODEC_GZIP] = load->gzip_path,
+    };
+    int repeats = (load->repeats > 0) ? load->repeats : 1;
+
+    cbor64_array_start(&streamer);
+
+    // Interleave the files, so that any drift over the run affects each
+    // alike.
+    for (int r = 0; r < repeats; r++) {
+        for (int codec = UBOOT_FS_CODEC_NONE; codec <= UBOOT_FS_CODEC_GZIP; codec++) {
+            if (paths[codec] == NULL) {
+                continue;
+            }
+            if (blk_bench_load_file(&streamer, load, paths[codec], codec, buffer,
+                                    buffer_size) != 0) {
+                failures++;
+            }
+        }
+    }
+
+    cbor64_array_end(&streamer);
+    base64_terminate(&streamer);
+
+    return failures;
+}
@@ -0,0 +1,226 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ */
+
+#include <string.h>
+#include <net_classify.h>
+
+#define ETH_HDR_LEN         14
+#define ETH_VLAN_TAG_LEN    4
+#define ETH_TYPE_VLAN       0x8100
+#define ETH_TYPE_IPV4       0x0800
+#define IPV4_MIN_HDR_LEN    20
+#define IPV4_PROTO_UDP      17
+#define IPV4_FLAG_MF        0x2000
+#define IPV4_OFFSET_MASK    0x1fff
+
+typedef struct {
+    uint64_t value;
+    int client;
+    net_classify_count_t count;
+} net_rule_t;
+
+/* Rules for a single field, sorted by value */
+typedef struct {
+    net_rule_t rules[NET_CLASSIFY_MAX_RULES];
+    int count;
+} net_table_t;
+
+static net_table_t tables[NET_MATCH_FIELDS];
+
+static int client_count = 0;
+static int default_client = 0;
+static net_classify_count_t default_count;
+static net_classify_count_t dropped_count;
+
+static inline uint16_t read_be16(const uint8_t *p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static int net_table_find(net_table_t *table, uint64_t value) {
+    int low = 0;
+    int high = table->count - 1;
+
+    while (low <= high) {
+        int mid = (low + high) / 2;
+
+        if (table->rules[mid].value == value) {
+            return mid;
+        } else if (table->rules[mid].value < value) {
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    return -1;
+}
+
+static bool net_classify_valid_client(int client) {
+    return client >= NET_CLASSIFY_DROP && client < client_count;
+}
+
+void net_classify_set_client_count(int count) {
+    client_count = count;
+}
+
+int net_classify_add_rule(net_match_t field, uint64_t value, int client) {
+    if (field >= NET_MATCH_FIELDS || !net_classify_valid_client(client)) {
+        return -1;
+    }
+
+    net_table_t *table = &tables[field];
+
+    // Replace the target of an existing rule.
+    int index = net_table_find(table, value);
+    if (index >= 0) {
+        table->rules[index].client = client;
+        return 0;
+    }
+
+    if (table->count == NET_CLASSIFY_MAX_RULES) {
+        return -1;
+    }
+
+    // Insert in order.
+    index = table->count;
+    while (index > 0 && table->rules[index - 1].value > value) {
+        table->rules[index] = table->rules[index - 1];
+        index--;
+    }
+
+    table->rules[index].value = value;
+    table->rules[index].client = client;
+    memset(&table->rules[index].count, 0, sizeof(net_classify_count_t));
+    table->count++;
+
+    return 0;
+}
+
+void net_classify_clear(void) {
+    memset(tables, 0, sizeof(tables));
+    default_client = 0;
+    memset(&default_count, 0, sizeof(default_count));
+    memset(&dropped_count, 0, sizeof(dropped_count));
+}
+
+int net_classify_set_default(int client) {
+    if (!net_classify_valid_client(client)) {
+        return -1;
+    }
+
+    default_client = client;
+    return 0;
+}
+
+static bool net_classify_match(net_match_t field, uint64_t value, int length, int *client) {
+    net_table_t *table = &tables[field];
+
+    if (table->count == 0) {
+        return false;
+    }
+
+    int index = net_table_find(table, value);
+    if (index < 0) {
+        return false;
+    }
+
+    net_rule_t *rule = &table->rules[index];
+    rule->count.frames++;
+    rule->count.bytes += length;
+    *client = rule->client;
+
+    return true;
+}
+
+static int net_classify_result(int client, int length) {
+    // The clients may since have been reduced below a rule's target.
+    if (client >= client_count) {
+        client = NET_CLASSIFY_DROP;
+    }
+
+    if (client == NET_CLASSIFY_DROP) {
+        dropped_count.frames++;
+        dropped_count.bytes += length;
+    }
+    return client;
+}
+
+int net_classify(const uint8_t *frame, int length) {
+    int client;
+
+    if (length < ETH_HDR_LEN) {
+        return net_classify_result(NET_CLASSIFY_DROP, length);
+    }
+
+    uint64_t dst_mac = 0;
+    for (int i = 0; i < 6; i++) {
+        dst_mac = (dst_mac << 8) | frame[i];
+    }
+
+    int offset = ETH_HDR_LEN;
+    uint16_t ethertype = read_be16(&frame[12]);
+    if (ethertype == ETH_TYPE_VLAN && length >= ETH_HDR_LEN + ETH_VLAN_TAG_LEN) {
+        ethertype = read_be16(&frame[16]);
+        offset += ETH_VLAN_TAG_LEN;
+    }
+
+    if (ethertype == ETH_TYPE_IPV4 && length >= offset + IPV4_MIN_HDR_LEN) {
+        const uint8_t *ip = &frame[offset];
+        int ip_hdr_len = (ip[0] & 0x0f) * 4;
+        uint8_t protocol = ip[9];
+        bool fragment = (read_be16(&ip[6]) & (IPV4_FLAG_MF | IPV4_OFFSET_MASK)) != 0;
+
+        // Ports are only present in the first fragment of a datagram, so
+        // fragments are classified without them in order that every
+        // fragment reaches the same client.
+        if (protocol == IPV4_PROTO_UDP && !fragment &&
+            ip_hdr_len >= IPV4_MIN_HDR_LEN && length >= offset + ip_hdr_len + 4) {
+            uint16_t dst_port = read_be16(&ip[ip_hdr_len + 2]);
+            if (net_classify_match(NET_MATCH_UDP_PORT, dst_port, length, &client)) {
+                return net_classify_result(client, length);
+            }
+        }
+
+        if (net_classify_match(NET_MATCH_IP_PROTO, protocol, length, &client)) {
+            return net_classify_result(client, length);
+        }
+    }
+
+    if (net_classify_match(NET_MATCH_ETHERTYPE, ethertype, length, &client)) {
+        return net_classify_result(client, length);
+    }
+
+    if (net_classify_match(NET_MATCH_DST_MAC, dst_mac, length, &client)) {
+        return net_classify_result(client, length);
+    }
+
+    default_count.frames++;
+    default_count.bytes += length;
+    return net_classify_result(default_client, length);
+}
+
+int net_classify_get_count(net_match_t field, uint64_t value, net_classify_count_t *count) {
+    if (field >= NET_MATCH_FIELDS) {
+        return -1;
+    }
+
+    int index = net_table_find(&tables[field], value);
+    if (index < 0) {
+        return -1;
+    }
+
+    *count = tables[field].rules[index].count;
+    return 0;
+}
+
+void net_classify_get_default_count(net_classify_count_t *count) {
+    *count = default_count;
+}
+
+void net_classify_get_dropped_count(net_classify_count_t *count) {
+    *count = dropped_count;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ */
+
+#include <net_queue.h>
+
+void net_queue_init(net_queue_handle_t *handle, uintptr_t free, uintptr_t active, uint32_t size) {
+    handle->free = (net_queue_t *)free;
+    handle->active = (net_queue_t *)active;
+    handle->size = size;
+}
+
+void net_queue_reset(net_queue_t *queue) {
+    queue->head = 0;
+    queue->tail = 0;
+    queue->signal_requested = false;
+}
+
+uint32_t net_queue_length(net_queue_t *queue) {
+    // The indices run freely and wrap naturally, so their difference is the
+    // number of entries held.
+    return queue->head - queue->tail;
+}
+
+bool net_queue_empty(net_queue_t *queue) {
+    return queue->head == queue->tail;
+}
+
+bool net_queue_full(net_queue_t *queue, uint32_t size) {
+    return (queue->head - queue->tail) == size;
+}
+
+int net_queue_enqueue(net_queue_t *queue, uint32_t size, net_buff_desc_t desc) {
+    if (net_queue_full(queue, size)) {
+        return -1;
+    }
+
+    queue->entries[queue->head & (size - 1)] = desc;
+
+    // Ensure the entry is written before it is published
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    queue->head = queue->head + 1;
+
+    return 0;
+}
+
+int net_queue_dequeue(net_queue_t *queue, uint32_t size, net_buff_desc_t *desc) {
+    if (net_queue_empty(queue)) {
+        return -1;
+    }
+
+    // Ensure the entry is not read before the head indicating it is valid
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    *desc = queue->entries[queue->tail & (size - 1)];
+
+    // Ensure the entry is read before it is released to the producer
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    queue->tail = queue->tail + 1;
+
+    return 0;
+}
+
+void net_queue_request_signal(net_queue_t *queue) {
+    queue->signal_requested = true;
+
+    // The consumer must re-check the queue after this returns, as the
+    // producer may have enqueued before seeing the request.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void net_queue_cancel_signal(net_queue_t *queue) {
+    queue->signal_requested = false;
+}
+
+bool net_queue_require_signal(net_queue_t *queue) {
+    // Order the producer's updates to head before the check of the request.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (!queue->signal_requested) {
+        return false;
+    }
+
+    queue->signal_requested = false;
+    return true;
+}
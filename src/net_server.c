@@ -0,0 +1,350 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <net_server.h>
+#include <net_classify.h>
+#include <uboot_drivers.h>
+
+/* Maximum number of frames received per poll of the device */
+#define NET_SERVER_RX_BUDGET    32
+
+/* Maximum number of frames passed to the device in a single burst */
+#define NET_SERVER_TX_BATCH     32
+
+/* Capacity of the table of receive buffers on loan to clients, a power of 2
+ * well above the number of spare receive buffers of the device */
+#define NET_SERVER_LOAN_BITS    10
+#define NET_SERVER_MAX_LOANS    (1u << NET_SERVER_LOAN_BITS)
+
+typedef struct {
+    uint64_t offset;    // offset of the buffer within the server's DMA region
+    int owner;          // client holding the buffer, or -1 if the entry is unused
+} net_server_loan_t;
+
+static net_server_config_t server;
+
+static bool notify_pending[NET_SERVER_MAX_CLIENTS];
+
+/* Receive buffers on loan to clients, so that a client can only return the
+ * buffers it was given. Open addressing with linear probing. */
+static net_server_loan_t loans[NET_SERVER_MAX_LOANS];
+static uint32_t loan_count;
+
+/* Number of frames from each client the device failed to send */
+static unsigned long tx_failed[NET_SERVER_MAX_CLIENTS];
+
+/* Whether a frame received outside the server's DMA region was reported */
+static bool rx_outside_reported;
+
+static void net_server_signal_clients(void) {
+    // Notify each client at most once per batch, and only if it is waiting.
+    for (int i = 0; i < server.client_count; i++) {
+        if (!notify_pending[i]) {
+            continue;
+        }
+        notify_pending[i] = false;
+
+        net_client_config_t *client = &server.clients[i];
+        if (net_queue_require_signal(client->rx.active) ||
+            net_queue_require_signal(client->tx.free)) {
+            microkit_notify(client->channel);
+        }
+    }
+}
+
+static uint32_t net_server_loan_slot(uint64_t offset) {
+    return ((uint32_t)(offset >> 6) * 0x9e3779b1u) >> (32 - NET_SERVER_LOAN_BITS);
+}
+
+static uint32_t net_server_loan_next(uint32_t slot) {
+    return (slot + 1) & (NET_SERVER_MAX_LOANS - 1);
+}
+
+static int net_server_loan_add(uint64_t offset, int owner) {
+    // Keep one entry unused so that every probe terminates.
+    if (loan_count == NET_SERVER_MAX_LOANS - 1) {
+        return -1;
+    }
+
+    uint32_t slot = net_server_loan_slot(offset);
+    while (loans[slot].owner >= 0) {
+        slot = net_server_loan_next(slot);
+    }
+
+    loans[slot].offset = offset;
+    loans[slot].owner = owner;
+    loan_count++;
+
+    return 0;
+}
+
+static int net_server_loan_remove(uint64_t offset, int owner) {
+    uint32_t slot = net_server_loan_slot(offset);
+    while (loans[slot].owner >= 0 && loans[slot].offset != offset) {
+        slot = net_server_loan_next(slot);
+    }
+
+    if (loans[slot].owner < 0 || loans[slot].owner != owner) {
+        return -1;
+    }
+
+    // Shift later entries of the probe sequence back into the gap, so that
+    // they can still be found without leaving markers behind.
+    uint32_t gap = slot;
+    for (uint32_t i = net_server_loan_next(slot); loans[i].owner >= 0; i = net_server_loan_next(i)) {
+        uint32_t home = net_server_loan_slot(loans[i].offset);
+        if (((i - home) & (NET_SERVER_MAX_LOANS - 1)) >= ((i - gap) & (NET_SERVER_MAX_LOANS - 1))) {
+            loans[gap] = loans[i];
+            gap = i;
+        }
+    }
+
+    loans[gap].owner = -1;
+    loan_count--;
+
+    return 0;
+}
+
+static void net_server_rx_return(void) {
+    // Return buffers the clients have finished with to the receive ring.
+    for (int i = 0; i < server.client_count; i++) {
+        net_client_config_t *client = &server.clients[i];
+        net_buff_desc_t desc;
+
+        while (net_queue_dequeue(client->rx.free, client->rx.size, &desc) == 0) {
+            // Only accept buffers on loan to this client, so that it cannot
+            // release those still held by another.
+            if (net_server_loan_remove(desc.offset, i) != 0) {
+                printf("NET_SERVER|ERROR: client %i returned invalid buffer 0x%llx\n",
+                    i, (unsigned long long)desc.offset);
+                continue;
+            }
+
+            unsigned char *packet = (unsigned char *)(server.rx_data + desc.offset);
+            uboot_eth_free_packet(&packet);
+        }
+    }
+}
+
+static void net_server_rx(void) {
+    unsigned char *packets[NET_SERVER_RX_BUDGET];
+    int lengths[NET_SERVER_RX_BUDGET];
+    int count;
+
+    // Drain the receive ring a budget at a time. The device interrupt stays
+    // masked until the ring is found empty; frames left waiting because all
+    // receive buffers are held by clients are collected once a client returns
+    // one, which signals the server.
+    do {
+        count = uboot_eth_irq_poll(packets, lengths, NET_SERVER_RX_BUDGET);
+        if (count < 0) {
+            return;
+        }
+
+        for (int i = 0; i < count; i++) {
+            // Only frames in the receive ring's buffers can be lent to clients;
+            // without the ring the driver returns a buffer of its own, reused
+            // for every frame.
+            uintptr_t packet = (uintptr_t)packets[i];
+            if (packet < server.rx_data || packet - server.rx_data >= server.rx_data_size ||
+                (size_t)lengths[i] > server.rx_data_size - (packet - server.rx_data)) {
+                if (!rx_outside_reported) {
+                    printf("NET_SERVER|ERROR: received frame outside DMA region, dropping\n");
+                    rx_outside_reported = true;
+                }
+                uboot_eth_free_packet(&packets[i]);
+                continue;
+            }
+
+            int index = net_classify(packets[i], lengths[i]);
+            if (index == NET_CLASSIFY_DROP) {
+                uboot_eth_free_packet(&packets[i]);
+                continue;
+            }
+
+            net_client_config_t *client = &server.clients[index];
+            net_buff_desc_t desc = {
+                .offset = packet - server.rx_data,
+                .length = lengths[i],
+            };
+
+            if (net_queue_full(client->rx.active, client->rx.size) ||
+                net_server_loan_add(desc.offset, index) != 0) {
+                // The client is not keeping up, drop the frame.
+                uboot_eth_free_packet(&packets[i]);
+                continue;
+            }
+            net_queue_enqueue(client->rx.active, client->rx.size, desc);
+            notify_pending[index] = true;
+        }
+
+        net_server_signal_clients();
+    } while (count == NET_SERVER_RX_BUDGET);
+}
+
+static void net_server_tx(void) {
+    unsigned char *packets[NET_SERVER_TX_BATCH];
+    int lengths[NET_SERVER_TX_BATCH];
+    net_buff_desc_t descs[NET_SERVER_TX_BATCH];
+    int owners[NET_SERVER_TX_BATCH];
+    int count;
+
+    do {
+        count = 0;
+
+        // Gather a batch of frames from all clients.
+        for (int i = 0; i < server.client_count && count < NET_SERVER_TX_BATCH; i++) {
+            net_client_config_t *client = &server.clients[i];
+
+            while (count < NET_SERVER_TX_BATCH &&
+                   net_queue_dequeue(client->tx.active, client->tx.size, &descs[count]) == 0) {
+                net_buff_desc_t *desc = &descs[count];
+
+                if (desc->length == 0 || desc->offset >= client->tx_data_size ||
+                    desc->length > client->tx_data_size - desc->offset) {
+                    printf("NET_SERVER|ERROR: client %i sent invalid buffer 0x%llx\n",
+                        i, (unsigned long long)desc->offset);
+                    net_queue_enqueue(client->tx.free, client->tx.size, *desc);
+                    notify_pending[i] = true;
+                    continue;
+                }
+
+                packets[count] = (unsigned char *)(client->tx_data + desc->offset);
+                lengths[count] = desc->length;
+                owners[count] = i;
+                count++;
+            }
+        }
+
+        if (count == 0) {
+            break;
+        }
+
+        // Queue the batch with a single notification to the device. Should
+        // the transmit ring fill, send the remainder individually, waiting for
+        // descriptors to be released.
+        int sent = uboot_eth_send_burst(packets, lengths, count);
+        if (sent < 0) {
+            sent = 0;
+        }
+        for (int i = sent; i < count; i++) {
+            if (uboot_eth_send(packets[i], lengths[i]) < 0) {
+                // Report the failure to the client by returning the buffer
+                // with no length.
+                descs[i].length = 0;
+                tx_failed[owners[i]]++;
+            }
+        }
+
+        // The frames have been copied onto the transmit ring, so the buffers
+        // can be returned immediately.
+        for (int i = 0; i < count; i++) {
+            net_client_config_t *client = &server.clients[owners[i]];
+            net_queue_enqueue(client->tx.free, client->tx.size, descs[i]);
+            notify_pending[owners[i]] = true;
+        }
+
+        net_server_signal_clients();
+    } while (count == NET_SERVER_TX_BATCH);
+
+    net_server_signal_clients();
+}
+
+static bool net_server_idle(void) {
+    bool idle = true;
+
+    // Ask to be signalled on further work, then check for any that raced
+    // with the request.
+    for (int i = 0; i < server.client_count; i++) {
+        net_client_config_t *client = &server.clients[i];
+
+        net_queue_request_signal(client->tx.active);
+        net_queue_request_signal(client->rx.free);
+
+        if (!net_queue_empty(client->tx.active) || !net_queue_empty(client->rx.free)) {
+            idle = false;
+        }
+    }
+
+    return idle;
+}
+
+int net_server_init(const net_server_config_t *config) {
+    if (config->client_count < 1 || config->client_count > NET_SERVER_MAX_CLIENTS) {
+        printf("NET_SERVER|ERROR: invalid client count %i\n", config->client_count);
+        return -1;
+    }
+
+    server = *config;
+
+    // The server owns initialisation of the shared queues, so must run before
+    // any of its clients (i.e. be of higher priority).
+    for (int i = 0; i < server.client_count; i++) {
+        net_client_config_t *client = &server.clients[i];
+
+        if (client->rx.size == 0 || (client->rx.size & (client->rx.size - 1)) != 0 ||
+            client->tx.size == 0 || (client->tx.size & (client->tx.size - 1)) != 0) {
+            printf("NET_SERVER|ERROR: queue sizes of client %i must be a power of 2\n", i);
+            return -1;
+        }
+
+        net_queue_reset(client->rx.free);
+        net_queue_reset(client->rx.active);
+        net_queue_reset(client->tx.free);
+        net_queue_reset(client->tx.active);
+        notify_pending[i] = false;
+        tx_failed[i] = 0;
+    }
+
+    net_classify_set_client_count(server.client_count);
+
+    for (uint32_t i = 0; i < NET_SERVER_MAX_LOANS; i++) {
+        loans[i].owner = -1;
+    }
+    loan_count = 0;
+    rx_outside_reported = false;
+
+    int ret = uboot_eth_init();
+    if (ret < 0) {
+        printf("NET_SERVER|ERROR: failed to initialise ethernet (%i)\n", ret);
+        return ret;
+    }
+
+    ret = uboot_eth_irq_enable(1);
+    if (ret < 0) {
+        printf("NET_SERVER|ERROR: failed to enable ethernet interrupt (%i)\n", ret);
+        return ret;
+    }
+
+    net_server_idle();
+
+    return 0;
+}
+
+unsigned long net_server_tx_failed(int client) {
+    if (client < 0 || client >= server.client_count) {
+        return 0;
+    }
+
+    return tx_failed[client];
+}
+
+void net_server_notified(microkit_channel ch) {
+    // Whatever the source of the notification, service all queues and the
+    // device until there is no work outstanding.
+    do {
+        net_server_rx_return();
+        net_server_rx();
+        net_server_tx();
+    } while (!net_server_idle());
+
+    if (ch == server.irq_channel) {
+        microkit_irq_ack(ch);
+    }
+}